@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Generates a perfect-hash classifier for the JSON keys the stop parser uses.
+
+Reads one key per line (blank lines and lines starting with '#' are ignored)
+and writes a header with an enum of the keys, their strings in JSON_KEY_NAMES
+and json_key_classify(), which maps a key string to its enum in O(1). The hash only looks at the key length
+and its first and last characters, so the multipliers and table size are
+searched here until every key lands in its own slot.
+"""
+
+import argparse
+import itertools
+import re
+import sys
+
+MAX_TABLE_BITS = 8
+
+
+def enum_name(key):
+    """Converts a CamelCase key to JSON_KEY_SNAKE_CASE."""
+    snake = re.sub(r"(?<=[a-z0-9])(?=[A-Z])|(?<=[A-Z])(?=[A-Z][a-z])", "_", key)
+    return "JSON_KEY_" + re.sub(r"\W", "_", snake).upper()
+
+
+def slot(key, mult, mask):
+    return (len(key) * mult[0] + ord(key[0]) * mult[1] + ord(key[-1]) * mult[2]) & mask
+
+
+def find_hash(keys):
+    for bits in range(max(1, (len(keys) - 1).bit_length()), MAX_TABLE_BITS + 1):
+        mask = (1 << bits) - 1
+        for mult in itertools.product(range(1, 32), repeat=3):
+            slots = {slot(key, mult, mask) for key in keys}
+            if len(slots) == len(keys):
+                return mult, mask
+    sys.exit("gen_json_keys.py: no perfect hash found, add a table bit")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("keys", help="File with one JSON key per line")
+    parser.add_argument("output", help="Generated header")
+    args = parser.parse_args()
+
+    with open(args.keys, encoding="utf-8") as f:
+        keys = [line.strip() for line in f if line.strip() and not line.startswith("#")]
+
+    if len(set(keys)) != len(keys):
+        sys.exit("gen_json_keys.py: duplicate keys in " + args.keys)
+
+    if len({enum_name(key) for key in keys}) != len(keys):
+        sys.exit("gen_json_keys.py: keys with the same enum name in " + args.keys)
+
+    mult, mask = find_hash(keys)
+    table = [None] * (mask + 1)
+    for key in keys:
+        table[slot(key, mult, mask)] = key
+
+    out = [
+        "/* Generated by scripts/gen_json_keys.py, do not edit. */",
+        "#ifndef JSON_KEYS_H",
+        "#define JSON_KEYS_H",
+        "",
+        "#include <stddef.h>",
+        "#include <string.h>",
+        "",
+        "enum json_key {",
+        "  JSON_KEY_UNKNOWN,",
+    ]
+    out += [f"  {enum_name(key)}," for key in keys]
+    out += [
+        "  /* Number of keys, including JSON_KEY_UNKNOWN */",
+        "  JSON_KEY_COUNT,",
+        "};",
+        "",
+        "/** Initializer of each key's string, indexed by enum json_key */",
+        "#define JSON_KEY_NAMES { \\",
+        "  NULL, \\",
+    ]
+    out += [f'  "{key}", \\' for key in keys]
+    out += [
+        "}",
+        "",
+        "/** Maps a key string to its enum json_key, or JSON_KEY_UNKNOWN. */",
+        "static inline enum json_key json_key_classify(const char *str, size_t len) {",
+        "  static const struct {",
+        "    enum json_key key;",
+        "    const char *name;",
+        "    size_t len;",
+        f"  }} table[{mask + 1}] = {{",
+    ]
+    for index, key in enumerate(table):
+        if key is not None:
+            out.append(f'    [{index}] = {{{enum_name(key)}, "{key}", {len(key)}}},')
+    out += [
+        "  };",
+        "",
+        "  if (len == 0) {",
+        "    return JSON_KEY_UNKNOWN;",
+        "  }",
+        "",
+        f"  const size_t i = ((len * {mult[0]}) + ((unsigned char)str[0] * {mult[1]}) +",
+        f"                    ((unsigned char)str[len - 1] * {mult[2]})) & {mask};",
+        "",
+        "  if ((table[i].len == len) && (memcmp(table[i].name, str, len) == 0)) {",
+        "    return table[i].key;",
+        "  }",
+        "  return JSON_KEY_UNKNOWN;",
+        "}",
+        "",
+        "#endif  // JSON_KEYS_H",
+        "",
+    ]
+
+    with open(args.output, "w", encoding="utf-8") as f:
+        f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
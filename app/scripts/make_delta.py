@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""Makes a delta patch from one signed firmware image to another.
+
+The patch is in the format net/delta_patch.h describes, and is served in place
+of the full image to boards that ask for it with ?from=<version of the running
+image>. Like bsdiff, runs of the new image that line up with the old one are
+stored as bytewise differences, mostly zeros once code has only moved, and
+everything else is inserted as is. With --gzip the patch is also compressed
+with a window CONFIG_HTTP_INFLATE_WINDOW_SIZE fits, to be served with
+Content-Encoding: gzip.
+
+Prints the sha-256 of the new image, which the server sends in the sha-256
+header with the patch just as it does with the full image.
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = 0x44424445
+# Bytes that must match exactly for a run to start
+KEY_SIZE = 8
+# A run ends once half the bytes of this window differ
+WINDOW = 64
+# Shorter runs are cheaper to insert than to add
+MIN_RUN = 32
+
+
+def index_source(source):
+    """Maps each KEY_SIZE bytes of source to where they first occur."""
+    index = {}
+    for pos in range(len(source) - KEY_SIZE + 1):
+        index.setdefault(source[pos : pos + KEY_SIZE], pos)
+    return index
+
+
+def extend(source, target, src, dst):
+    """Returns the length of the run of target from dst that lines up with
+    source from src, ending at the last matching byte."""
+    length = 0
+    end = 0
+    misses = 0
+    limit = min(len(source) - src, len(target) - dst)
+    while length < limit:
+        if source[src + length] == target[dst + length]:
+            end = length + 1
+        else:
+            misses += 1
+        if length >= WINDOW and source[src + length - WINDOW] != target[dst + length - WINDOW]:
+            misses -= 1
+        if misses > WINDOW // 2:
+            break
+        length += 1
+    return end
+
+
+def find_runs(source, target):
+    """Yields (dst, src, length) runs of target that are stored as
+    differences, in target order."""
+    index = index_source(source)
+    offset = 0
+    dst = 0
+    while dst <= len(target) - KEY_SIZE:
+        key = target[dst : dst + KEY_SIZE]
+        candidates = [dst + offset] if 0 <= dst + offset <= len(source) - KEY_SIZE else []
+        if key in index:
+            candidates.append(index[key])
+        best = (0, 0)
+        for src in candidates:
+            if source[src : src + KEY_SIZE] == key:
+                best = max(best, (extend(source, target, src, dst), src))
+        if best[0] >= MIN_RUN:
+            length, src = best
+            yield dst, src, length
+            offset = src - dst
+            dst += length
+        else:
+            dst += 1
+
+
+def make_patch(source, target):
+    records = []
+    src_pos = 0
+    dst_pos = 0
+    # The first record only inserts, up to the first run
+    add = (0, 0)
+    for dst, src, length in find_runs(source, target):
+        records.append((add, target[dst_pos:dst], src - src_pos))
+        add = (src, length)
+        src_pos = src + length
+        dst_pos = dst + length
+    records.append((add, target[dst_pos:], 0))
+
+    out = [struct.pack("<IIII", MAGIC, len(source), zlib.crc32(source), len(target))]
+    dst = 0
+    for (src, length), insert, seek in records:
+        diff = bytes((target[dst + i] - source[src + i]) & 0xFF for i in range(length))
+        out += [struct.pack("<IIi", length, len(insert), seek), diff, insert]
+        dst += length + len(insert)
+    assert dst == len(target)
+    return b"".join(out)
+
+
+def apply_patch(source, patch):
+    """Applies patch the way the board does, to check it."""
+    magic, source_size, crc, target_size = struct.unpack_from("<IIII", patch)
+    assert magic == MAGIC and source_size == len(source) and crc == zlib.crc32(source)
+    target = bytearray()
+    pos = 16
+    src = 0
+    while len(target) < target_size:
+        add, insert, seek = struct.unpack_from("<IIi", patch, pos)
+        pos += 12
+        target += bytes((patch[pos + i] + source[src + i]) & 0xFF for i in range(add))
+        src += add
+        pos += add
+        target += patch[pos : pos + insert]
+        pos += insert
+        src += seek
+    assert pos == len(patch)
+    return bytes(target)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("source", help="Signed image the board runs")
+    parser.add_argument("target", help="Signed image to update it to")
+    parser.add_argument("output", help="Patch")
+    parser.add_argument(
+        "--gzip", action="store_true", help="Also write the patch compressed to <output>.gz"
+    )
+    parser.add_argument(
+        "--window-bits", type=int, default=13, help="Compression window, 13 is 8 KB"
+    )
+    args = parser.parse_args()
+
+    with open(args.source, "rb") as f:
+        source = f.read()
+    with open(args.target, "rb") as f:
+        target = f.read()
+
+    patch = make_patch(source, target)
+    if apply_patch(source, patch) != target:
+        sys.exit("make_delta.py: the patch doesn't make the target image")
+
+    with open(args.output, "wb") as f:
+        f.write(patch)
+    size = len(patch)
+    if args.gzip:
+        compressor = zlib.compressobj(9, zlib.DEFLATED, 16 + args.window_bits)
+        compressed = compressor.compress(patch) + compressor.flush()
+        with open(args.output + ".gz", "wb") as f:
+            f.write(compressed)
+        size = len(compressed)
+
+    print(f"{len(target)} byte image, {size} byte patch")
+    print("sha-256:", hashlib.sha256(target).hexdigest())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,44 @@
+/** @headerfile arena.h */
+#include "arena.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_REGISTER(arena);
+
+#define ARENA_ALIGN 8
+
+static uint8_t arena_buf[CONFIG_SCRATCH_ARENA_SIZE] __aligned(ARENA_ALIGN);
+static size_t arena_used;
+static size_t arena_peak;
+
+void *arena_alloc(size_t size) {
+  size = ROUND_UP(size, ARENA_ALIGN);
+
+  if (size > (sizeof(arena_buf) - arena_used)) {
+    LOG_ERR(
+        "Scratch arena exhausted; requested: %d, used: %d/%d", size, arena_used,
+        sizeof(arena_buf)
+    );
+    return NULL;
+  }
+
+  void *ptr = &arena_buf[arena_used];
+  arena_used += size;
+
+  if (arena_used > arena_peak) {
+    arena_peak = arena_used;
+  }
+
+  return ptr;
+}
+
+size_t arena_mark(void) { return arena_used; }
+
+void arena_release(size_t mark) {
+  __ASSERT(mark <= arena_used, "Arena released past its current position");
+  arena_used = mark;
+}
+
+size_t arena_high_water(void) { return arena_peak; }
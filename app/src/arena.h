@@ -0,0 +1,33 @@
+/** @file arena.h
+ *  @brief Scratch arena shared by short-lived buffers.
+ *
+ *  A bump allocator over a static CONFIG_SCRATCH_ARENA_SIZE buffer. Callers
+ *  take a mark, allocate what they need and release back to the mark when
+ *  done, so the stop JSON tokens, receive buffers and FOTA write buffer all
+ *  reuse the same memory instead of each living on the main stack.
+ *
+ *  It is not thread safe. Stop requests use it from the HTTP work queue, so
+ *  anything else using it has to run there too, see http_submit().
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/** @brief Allocates size bytes, 8 byte aligned.
+ *
+ *  @return NULL if the arena doesn't have size bytes left.
+ */
+void *arena_alloc(size_t size);
+
+/** @brief Returns the current arena position to later release back to. */
+size_t arena_mark(void);
+
+/** @brief Frees everything allocated since mark was taken. */
+void arena_release(size_t mark);
+
+/** @brief Returns the largest number of bytes that have been in use at once. */
+size_t arena_high_water(void);
+
+#endif  // ARENA_H
@@ -0,0 +1,273 @@
+#ifdef CONFIG_STOP_REQUEST_JES_CBOR
+
+/** @headerfile stop_cbor.h */
+#include "cbor/stop_cbor.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <zcbor_decode.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "json/stop_schema.h"
+#include "stop.h"
+#include "string_table.h"
+
+LOG_MODULE_REGISTER(stop_cbor);
+
+/** Map keys, see stop.cddl */
+enum stop_cbor_key { STOP_CBOR_UPDATED = 0, STOP_CBOR_STOP_ID = 1, STOP_CBOR_ROUTES = 2 };
+enum route_cbor_key { ROUTE_CBOR_ID = 0, ROUTE_CBOR_DIR = 1, ROUTE_CBOR_DEPS = 2 };
+enum dep_cbor_key { DEP_CBOR_TEXT = 0, DEP_CBOR_ETD = 1 };
+
+/** stop map, routes list, route map, deps list and dep map */
+#define STOP_CBOR_MAX_DEPTH 5
+
+static bool decode_departure(zcbor_state_t *state, Departure *departure, StopSchemaCtx *ctx) {
+  struct zcbor_string text;
+  uint32_t key;
+  uint32_t etd;
+  int id;
+
+  if (!zcbor_map_start_decode(state)) {
+    return false;
+  }
+
+  while (!zcbor_array_at_end(state)) {
+    if (!zcbor_uint32_decode(state, &key)) {
+      return false;
+    }
+
+    switch (key) {
+      case DEP_CBOR_TEXT:
+        if (!zcbor_tstr_decode(state, &text)) {
+          return false;
+        }
+        id = string_table_intern(ctx->texts, (const char *)text.value, text.len);
+        departure->text = (id < 0) ? STRING_ID_EMPTY : id;
+        break;
+      case DEP_CBOR_ETD:
+        if (!zcbor_uint32_decode(state, &etd)) {
+          return false;
+        }
+        departure->etd = etd;
+        break;
+      default:
+        if (!zcbor_any_skip(state, NULL)) {
+          return false;
+        }
+        break;
+    }
+  }
+
+  return zcbor_map_end_decode(state);
+}
+
+static bool decode_departures(
+    zcbor_state_t *state, RouteDirection *route_direction, StopSchemaCtx *ctx
+) {
+  if (!zcbor_list_start_decode(state)) {
+    return false;
+  }
+
+  while (!zcbor_array_at_end(state)) {
+    if (route_direction->departures_size == CONFIG_ROUTE_MAX_DEPARTURES) {
+      if (!zcbor_any_skip(state, NULL)) {
+        return false;
+      }
+      continue;
+    }
+
+    Departure *departure = &route_direction->departures[route_direction->departures_size];
+
+    (void)memset(departure, 0, sizeof(*departure));
+    if (!decode_departure(state, departure, ctx)) {
+      return false;
+    }
+    if (stop_departure_accept(
+            departure, route_direction, route_direction->departures_size, ctx
+        )) {
+      route_direction->departures_size++;
+    }
+  }
+
+  return zcbor_list_end_decode(state);
+}
+
+static bool decode_route(
+    zcbor_state_t *state, RouteDirection *route_direction, StopSchemaCtx *ctx
+) {
+  struct zcbor_string dir;
+  uint32_t key;
+  int32_t id;
+
+  if (!zcbor_map_start_decode(state)) {
+    return false;
+  }
+
+  while (!zcbor_array_at_end(state)) {
+    if (!zcbor_uint32_decode(state, &key)) {
+      return false;
+    }
+
+    switch (key) {
+      case ROUTE_CBOR_ID:
+        if (!zcbor_int32_decode(state, &id)) {
+          return false;
+        }
+        route_direction->id = id;
+        break;
+      case ROUTE_CBOR_DIR:
+        if (!zcbor_tstr_decode(state, &dir)) {
+          return false;
+        }
+        route_direction->direction_code = (dir.len > 0) ? dir.value[0] : '\0';
+        break;
+      case ROUTE_CBOR_DEPS:
+        if (!decode_departures(state, route_direction, ctx)) {
+          return false;
+        }
+        break;
+      default:
+        if (!zcbor_any_skip(state, NULL)) {
+          return false;
+        }
+        break;
+    }
+  }
+
+  return zcbor_map_end_decode(state);
+}
+
+static bool decode_routes(zcbor_state_t *state, Stop *stop, StopSchemaCtx *ctx) {
+  if (!zcbor_list_start_decode(state)) {
+    return false;
+  }
+
+  while (!zcbor_array_at_end(state)) {
+    if (stop->routes_size == CONFIG_STOP_MAX_ROUTES) {
+      LOG_WRN("More than CONFIG_STOP_MAX_ROUTES (%d) routes, skipping.", CONFIG_STOP_MAX_ROUTES);
+      if (!zcbor_any_skip(state, NULL)) {
+        return false;
+      }
+      continue;
+    }
+
+    RouteDirection *route_direction = &stop->route_directions[stop->routes_size];
+
+    (void)memset(route_direction, 0, sizeof(*route_direction));
+    if (!decode_route(state, route_direction, ctx)) {
+      return false;
+    }
+    if (stop_route_accept(route_direction, stop, stop->routes_size, ctx)) {
+      stop->routes_size++;
+    }
+  }
+
+  return zcbor_list_end_decode(state);
+}
+
+/** Whether a feed is for the stop that was requested, stop->id. */
+static bool stop_id_matches(const Stop *stop, uint32_t stop_id) {
+  char id[sizeof("4294967295")];
+
+  (void)snprintf(id, sizeof(id), "%u", stop_id);
+  return strcmp(id, stop->id) == 0;
+}
+
+static bool decode_stop(zcbor_state_t *state, Stop *stop, StopSchemaCtx *ctx) {
+  uint64_t updated;
+  uint32_t stop_id;
+  uint32_t key;
+
+  if (!zcbor_map_start_decode(state)) {
+    return false;
+  }
+
+  while (!zcbor_array_at_end(state)) {
+    if (!zcbor_uint32_decode(state, &key)) {
+      return false;
+    }
+
+    switch (key) {
+      case STOP_CBOR_UPDATED:
+        if (!zcbor_uint64_decode(state, &updated)) {
+          return false;
+        }
+        stop->last_updated = updated;
+        break;
+      case STOP_CBOR_STOP_ID:
+        if (!zcbor_uint32_decode(state, &stop_id)) {
+          return false;
+        }
+        if (!stop_id_matches(stop, stop_id)) {
+          LOG_ERR("Got the feed of stop %u instead of %s", stop_id, stop->id);
+          zcbor_error(state, ZCBOR_ERR_WRONG_VALUE);
+          return false;
+        }
+        break;
+      case STOP_CBOR_ROUTES:
+        if (!decode_routes(state, stop, ctx)) {
+          return false;
+        }
+        break;
+      default:
+        if (!zcbor_any_skip(state, NULL)) {
+          return false;
+        }
+        break;
+    }
+  }
+
+  return zcbor_map_end_decode(state);
+}
+
+int stop_cbor_feed(const char *data, size_t len, void *user_data) {
+  StopParser *parser = user_data;
+
+  parser->bytes += len;
+  if (len > (parser->element_size - parser->element_len)) {
+    parser->element_overflow = true;
+    return 0;
+  }
+
+  (void)memcpy(&parser->element[parser->element_len], data, len);
+  parser->element_len += len;
+  return 0;
+}
+
+int stop_cbor_finish(StopParser *parser) {
+  Stop *stop = parser->stop;
+  const uint32_t start = k_cycle_get_32();
+  int err = 0;
+
+  if (parser->element_overflow) {
+    LOG_ERR("Stop CBOR larger than %d bytes", parser->element_size);
+    return 1;
+  }
+
+  if (parser->element_len == 0) {
+    LOG_INF("No scheduled departures");
+    return 5;
+  }
+
+  ZCBOR_STATE_D(
+      state, STOP_CBOR_MAX_DEPTH, (const uint8_t *)parser->element, parser->element_len, 1, 0
+  );
+
+  if (!decode_stop(state, stop, &parser->ctx)) {
+    err = zcbor_peek_error(state);
+    LOG_ERR("Failed to decode stop CBOR: %d", err);
+    LOG_HEXDUMP_DBG(parser->element, parser->element_len, "Stop:");
+    /* Running out of payload means the transfer was cut short */
+    err = (err == ZCBOR_ERR_NO_PAYLOAD) ? 3 : 1;
+  } else if (stop->routes_size == 0) {
+    LOG_WRN("No routes with departures.");
+  }
+
+  parser->cycles += k_cycle_get_32() - start;
+  LOG_DBG("LastUpdated: %llu", stop->last_updated);
+  return err;
+}
+
+#endif  // CONFIG_STOP_REQUEST_JES_CBOR
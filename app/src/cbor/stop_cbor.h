@@ -0,0 +1,29 @@
+/** @file stop_cbor.h
+ *  @brief Decoder for the JES stop feed in CBOR, see stop.cddl.
+ *
+ *  Shares the StopParser with the JSON parser. The body is small enough to be
+ *  buffered whole in the parser's element buffer and decoded in one pass once
+ *  it has all arrived.
+ */
+
+#ifndef STOP_CBOR_H
+#define STOP_CBOR_H
+
+#include <stddef.h>
+
+#include "json/jsmn_parse.h"
+
+/** Buffers a chunk of the response body, matches http_body_cb_t.
+ *
+ *  @param user_data The StopParser, set up with stop_parser_init().
+ */
+int stop_cbor_feed(const char *data, size_t len, void *user_data);
+
+/** Decodes the buffered body into the Stop.
+ *
+ *  @return 0 on success, 3 if the body was cut short, 5 if it was empty, or
+ *  1 on any other error, the same codes stop_parser_finish() uses.
+ */
+int stop_cbor_finish(StopParser *parser);
+
+#endif  // STOP_CBOR_H
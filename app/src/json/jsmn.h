@@ -25,6 +25,10 @@
 #define JSMN_H
 
 #include <stddef.h>
+#ifdef JSMN_SWAR
+#include <stdint.h>
+#include <string.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -65,6 +69,7 @@ enum jsmnerr {
  * type		type (object, array, string etc.)
  * start	start position in JSON data string
  * end		end position in JSON data string
+ * next		index of the first token after this token's subtree
  */
 typedef struct jsmntok {
   jsmntype_t type;
@@ -74,6 +79,9 @@ typedef struct jsmntok {
 #ifdef JSMN_PARENT_LINKS
   int parent;
 #endif
+#ifdef JSMN_NEXT_LINKS
+  int next;
+#endif
 } jsmntok_t;
 
 /**
@@ -99,6 +107,14 @@ JSMN_API void jsmn_init(jsmn_parser *parser);
 JSMN_API int jsmn_parse(jsmn_parser *parser, const char *js, const size_t len,
                         jsmntok_t *tokens, const unsigned int num_tokens);
 
+#ifdef JSMN_SWAR
+/**
+ * Returns the length of the run of string characters at js, up to the first
+ * quote, backslash or NUL, or len if there is none.
+ */
+JSMN_API size_t jsmn_scan_string(const char *js, const size_t len);
+#endif
+
 #ifndef JSMN_HEADER
 /**
  * Allocates a fresh unused token from the token pool.
@@ -114,6 +130,11 @@ static jsmntok_t *jsmn_alloc_token(jsmn_parser *parser, jsmntok_t *tokens,
   tok->size = 0;
 #ifdef JSMN_PARENT_LINKS
   tok->parent = -1;
+#endif
+#ifdef JSMN_NEXT_LINKS
+  /* Strings and primitives have no children, objects and arrays are updated
+   * when they are closed */
+  tok->next = parser->toknext;
 #endif
   return tok;
 }
@@ -129,6 +150,31 @@ static void jsmn_fill_token(jsmntok_t *token, const jsmntype_t type,
   token->size = 0;
 }
 
+#ifdef JSMN_SWAR
+/* Sets the high bit of every byte of w that is zero. Bytes above the first
+ * zero byte can be false positives, so it's only used to find the word. */
+#define JSMN_SWAR_ZERO(w) (((w) - 0x01010101u) & ~(w) & 0x80808080u)
+
+JSMN_API size_t jsmn_scan_string(const char *js, const size_t len) {
+  size_t i = 0;
+
+  /* Test 4 bytes per word until one holds a quote, backslash or NUL */
+  for (; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+    uint32_t w;
+    memcpy(&w, js + i, sizeof(w));
+    if (JSMN_SWAR_ZERO(w ^ 0x22222222u) | JSMN_SWAR_ZERO(w ^ 0x5C5C5C5Cu) |
+        JSMN_SWAR_ZERO(w)) {
+      break;
+    }
+  }
+
+  /* Pin down the exact byte in the word, or finish the tail */
+  for (; i < len && js[i] != '\"' && js[i] != '\\' && js[i] != '\0'; i++) {
+  }
+  return i;
+}
+#endif
+
 /**
  * Fills next available token with JSON primitive.
  */
@@ -201,6 +247,13 @@ static int jsmn_parse_string(jsmn_parser *parser, const char *js,
   parser->pos++;
 
   for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++) {
+#ifdef JSMN_SWAR
+    /* Jump over the plain characters to the next quote or backslash */
+    parser->pos += jsmn_scan_string(js + parser->pos, len - parser->pos);
+    if (parser->pos >= len || js[parser->pos] == '\0') {
+      break;
+    }
+#endif
     char c = js[parser->pos];
 
     /* Quote: end of string */
@@ -322,6 +375,9 @@ JSMN_API int jsmn_parse(jsmn_parser *parser, const char *js, const size_t len,
             return JSMN_ERROR_INVAL;
           }
           token->end = parser->pos + 1;
+#ifdef JSMN_NEXT_LINKS
+          token->next = parser->toknext;
+#endif
           parser->toksuper = token->parent;
           break;
         }
@@ -342,6 +398,9 @@ JSMN_API int jsmn_parse(jsmn_parser *parser, const char *js, const size_t len,
           }
           parser->toksuper = -1;
           token->end = parser->pos + 1;
+#ifdef JSMN_NEXT_LINKS
+          token->next = parser->toknext;
+#endif
           break;
         }
       }
@@ -7,344 +7,378 @@
 
 #define JSMN_HEADER
 
+#include "arena.h"
 #include "json/jsmn.h"
 #include "json/json_helpers.h"
+#include "json/json_schema.h"
+#include "json/stop_schema.h"
 #include "stop.h"
 
 LOG_MODULE_REGISTER(jsmn_parse);
 
-/** The number of keys + values in for each object type in our JSON string */
-#define DEPARTURE_TOK_COUNT 18
-#define HEADWAY_TOK_COUNT 14
-#define ROUTE_DIRECTION_TOK_COUNT \
-  (12 + (CONFIG_ROUTE_MAX_DEPARTURES * (DEPARTURE_TOK_COUNT + HEADWAY_TOK_COUNT)))
-#define STOP_TOK_COUNT (6 + (CONFIG_STOP_MAX_ROUTES * ROUTE_DIRECTION_TOK_COUNT))
-
-/** With jsmn JSON objects count as a token, so we need to offset by an
- *  additional 1 for each level deeper we go.
- *  These offsets need to be temporary though, because objects don't have a
- *  value to account for. At least that's what I believe the reason to be...
+/** Tokenizes a single routes element and fills the next free route from it.
+ *
+ *  Returns 1 if the route was kept, 0 if it should be skipped, or the
+ *  eval_jsmn_return() error if the element couldn't be tokenized.
  */
-// #define STOP_TOK tokens[t + 1]
-#define ROUTE_DIRECTION_TOK tokens[t + rdir + 2]
-#define DEPARTURE_TOK tokens[t + rdir + dep + 3]
+static int parse_route(StopParser *parser) {
+  const char *const json_ptr = parser->element;
+  const size_t len = parser->element_len;
+  const json_field *field = parser->routes;
+  Stop *stop = parser->stop;
+  jsmn_parser p;
+  jsmntok_t *tokens;
 
-static int unique_disply_text(
-    const char *const json_ptr, RouteDirection *route_direction,
-    const jsmntok_t *tok, size_t valid_departure_count
-) {
-  for (size_t i = 0; i < valid_departure_count; i++) {
-    Departure *departure = &route_direction->departures[i];
-    if (jsoneq(json_ptr, tok, departure->display_text)) {
-      return 0;
+  int ret;
+
+  /* jsmn only counts the tokens when none are given, which lets the token
+   * array be sized to this route rather than the worst case. */
+  jsmn_init(&p);
+  ret = jsmn_parse(&p, json_ptr, len, NULL, 0);
+  if (ret < 0) {
+    ret = eval_jsmn_return(ret);
+    LOG_ERR("Failed to parse %s JSON", field->schema->name);
+    return -ret;
+  }
+
+  const size_t token_count = ret;
+  const size_t mark = arena_mark();
+
+  parser->max_route_tokens = MAX(parser->max_route_tokens, token_count);
+
+  tokens = arena_alloc(token_count * sizeof(jsmntok_t));
+  if (tokens == NULL) {
+    /* A sizing problem rather than a bad response, the rest of the stop is
+     * still shown */
+    LOG_WRN(
+        "%s element needs %zu tokens, %zu bytes, only %zu bytes left in the scratch arena; "
+        "skipping.",
+        field->schema->name, token_count, token_count * sizeof(jsmntok_t),
+        CONFIG_SCRATCH_ARENA_SIZE - mark
+    );
+    return 0;
+  }
+
+  jsmn_init(&p);
+  ret = jsmn_parse(&p, json_ptr, len, tokens, token_count);
+
+  ret = eval_jsmn_return(ret);
+  if (ret) {
+    LOG_ERR("Failed to parse %s JSON", field->schema->name);
+    arena_release(mark);
+    return -ret;
+  }
+
+  LOG_DBG("Tokens allocated: %d", token_count);
+
+  ret = json_schema_walk_element(json_ptr, tokens, 0, field, stop, &parser->ctx);
+
+#ifdef CONFIG_DEBUG
+  if (ret) {
+    const RouteDirection *route_direction = &stop->route_directions[stop->routes_size - 1];
+    LOG_DBG("- Route: %d, Direction: %c", route_direction->id, route_direction->direction_code);
+    for (int i = 0; i < route_direction->departures_size; i++) {
+      LOG_DBG(
+          "Uniq display text(s) %d: %s", i,
+          string_table_get(&stop->texts, route_direction->departures[i].text)
+      );
     }
   }
-  return 1;
+#endif  // CONFIG_DEBUG
+
+  arena_release(mark);
+  return ret;
 }
 
-/** Iterates through the Departures array objects to find desired values. */
-#ifdef CONFIG_STOP_REQUEST_BUSTRACKER
-static int parse_departures(
-    const char *const json_ptr, int t, jsmntok_t tokens[], int rdir,
-    size_t departures_count, RouteDirection *route_direction, const int time_now
-) {
-  size_t valid_departure_count = 0;
-
-  for (int dep_num = 0; dep_num < departures_count; dep_num++) {
-    Departure *departure = &route_direction->departures[valid_departure_count];
-    int departure_uniq = 0;
-    int edt_in_future = 0;
-
-    /** Increase t by 1 to step into the object */
-    t++;
-
-    /** The number of keys in the Departure object.
-     *
-     *  ROUTE_DIRECTION_TOK is a Departure object,
-     *  so ROUTE_DIRECTION_TOK.size is the number of Departure keys.
-     */
-    const size_t departure_size = ROUTE_DIRECTION_TOK.size;
-    LOG_DBG(
-        "***********Start Departure (t: %d, dep_num: %d, departure_size: "
-        "%d)**********",
-        t, dep_num, departure_size
+/** Called once a complete routes element has been buffered. */
+static void stop_parser_end_element(StopParser *parser) {
+  Stop *stop = parser->stop;
+  int ret;
+
+  if (parser->element_overflow) {
+    LOG_WRN(
+        "%s element larger than %d bytes, skipping.", parser->routes->schema->name,
+        parser->element_size
     );
-    for (int dep = 0; dep < (departure_size * 2); dep++) {
-      if (jsoneq(json_ptr, &DEPARTURE_TOK, "DisplayText")) {
-        dep++;
-        departure_uniq = unique_disply_text(
-            json_ptr, route_direction, &DEPARTURE_TOK, valid_departure_count
-        );
-
-        if (departure_uniq) {
-          memcpy(
-              departure->display_text, json_ptr + DEPARTURE_TOK.start,
-              DEPARTURE_TOK.end - DEPARTURE_TOK.start
-          );
-          departure->display_text[(DEPARTURE_TOK.end - DEPARTURE_TOK.start)] =
-              '\0';
-          if (edt_in_future) {
-            goto check_validity;
-          }
-        } else {
-          break;
+    return;
+  }
+
+  if (stop->routes_size == CONFIG_STOP_MAX_ROUTES) {
+    LOG_WRN("More than CONFIG_STOP_MAX_ROUTES (%d) routes, skipping.", CONFIG_STOP_MAX_ROUTES);
+    return;
+  }
+
+  ret = parse_route(parser);
+  if (ret < 0) {
+    LOG_DBG("%s:\n%.*s", parser->routes->schema->name, parser->element_len, parser->element);
+    parser->err = -ret;
+  }
+}
+
+/** Appends a character to the stop object buffer. */
+static void stop_parser_scaffold_put(StopParser *parser, char c) {
+  if (parser->scaffold_len < (sizeof(parser->scaffold) - 1)) {
+    parser->scaffold[parser->scaffold_len++] = c;
+  } else if (parser->err == 0) {
+    LOG_ERR("Stop object members larger than %d bytes", sizeof(parser->scaffold));
+    parser->err = 1;
+  }
+}
+
+/** Appends a character to the routes element buffer. */
+static void stop_parser_element_put(StopParser *parser, char c) {
+  if (parser->element_len < parser->element_size) {
+    parser->element[parser->element_len++] = c;
+  } else {
+    parser->element_overflow = true;
+  }
+}
+
+#ifdef JSMN_SWAR
+/** Appends a run of string characters to the stop object buffer. */
+static void stop_parser_scaffold_write(StopParser *parser, const char *data, size_t len) {
+  if (len < (sizeof(parser->scaffold) - parser->scaffold_len)) {
+    (void)memcpy(&parser->scaffold[parser->scaffold_len], data, len);
+    parser->scaffold_len += len;
+  } else if (parser->err == 0) {
+    LOG_ERR("Stop object members larger than %d bytes", sizeof(parser->scaffold));
+    parser->err = 1;
+  }
+}
+
+/** Appends a run of string characters to the routes element buffer. */
+static void stop_parser_element_write(StopParser *parser, const char *data, size_t len) {
+  if (len <= (parser->element_size - parser->element_len)) {
+    (void)memcpy(&parser->element[parser->element_len], data, len);
+    parser->element_len += len;
+  } else {
+    parser->element_overflow = true;
+  }
+}
+#endif  // JSMN_SWAR
+
+void stop_parser_init(
+    StopParser *parser, Stop *stop, unsigned int time_now, char *element_buf,
+    size_t element_buf_size
+) {
+  (void)memset(parser, 0, offsetof(StopParser, scaffold));
+  parser->stop = stop;
+  stop_schema_ctx_init(&parser->ctx, &stop->texts, time_now);
+  parser->element = element_buf;
+  parser->element_size = element_buf_size;
+  parser->key_start = -1;
+}
+
+void stop_parser_clear_stop(StopParser *parser) {
+  string_table_clear(parser->ctx.texts);
+  parser->stop->routes_size = 0;
+}
+
+/** Splits the incoming bytes into the stop object members, which are kept in
+ *  the scaffold buffer, and elements of the stop_schema streamed routes array,
+ *  which are buffered and parsed one at a time as soon as each element's
+ *  closing brace arrives.
+ *
+ *  The routes array is left in the scaffold as an empty array.
+ */
+int stop_parser_feed(const char *data, size_t len, void *user_data) {
+  StopParser *parser = user_data;
+  const uint32_t start = k_cycle_get_32();
+
+  parser->bytes += len;
+
+  for (size_t i = 0; (i < len) && (parser->err == 0); i++) {
+    const char c = data[i];
+    /* Bytes inside the routes array belong to the current element */
+    const bool in_element = parser->in_routes && (parser->depth > parser->stop_depth + 1);
+
+    if (parser->in_string) {
+#ifdef JSMN_SWAR
+      /* Copy the run up to the next quote or backslash in one go, only those
+       * two can change the parser state inside a string. */
+      const size_t run = parser->escape ? 0 : jsmn_scan_string(&data[i], len - i);
+      if (run > 0) {
+        if (in_element) {
+          stop_parser_element_write(parser, &data[i], run);
+        } else if (!parser->in_routes) {
+          stop_parser_scaffold_write(parser, &data[i], run);
         }
-      } else if (jsoneq(json_ptr, &DEPARTURE_TOK, "EDT")) {
-        dep++;
-        /* EDT ex: /Date(1648627309163-0400)\, where 1648627309163 is ms since
-         * the epoch. We increase the pointer by 6 to remove the leading
-         * '/Date(' for atoi(). This also ignores the timezone which we don't
-         * need.
-         */
-        char edt_string[10];
-        (void)memcpy(edt_string, json_ptr + DEPARTURE_TOK.start + 7, 10);
-
-        // const char *const edt_string = json_ptr + DEPARTURE_TOK.start +
-        // 7;
-        unsigned int edt = atoi(edt_string);
-        LOG_DBG("* EDT: %u", edt);
-        if (edt > time_now) {
-          departure->etd = edt;
-          edt_in_future = true;
-          if (departure_uniq) {
-            goto check_validity;
-          }
-        } else if (departure_uniq) {
-          departure->display_text[0] = '\0';
-          break;
-        } else {
-          break;
+        i += run - 1;
+        continue;
+      }
+#endif  // JSMN_SWAR
+      if (parser->escape) {
+        parser->escape = false;
+      } else if (c == '\\') {
+        parser->escape = true;
+      } else if (c == '\"') {
+        parser->in_string = false;
+        if ((parser->key_start >= 0) && (parser->key_end < 0)) {
+          parser->key_end = parser->scaffold_len;
         }
-      } else if (jsoneq(json_ptr, &DEPARTURE_TOK, "ETA")) {
-        dep++;
-      } else if (jsoneq(json_ptr, &DEPARTURE_TOK, "GoogleTripId")) {
-        dep++;
-      } else if (jsoneq(json_ptr, &DEPARTURE_TOK, "LastUpdated")) {
-        dep++;
-      } else if (jsoneq(json_ptr, &DEPARTURE_TOK, "SDT")) {
-        dep++;
-      } else if (jsoneq(json_ptr, &DEPARTURE_TOK, "STA")) {
-        dep++;
-      } else if (jsoneq(json_ptr, &DEPARTURE_TOK, "VehicleId")) {
-        dep++;
-      } else {
-        dep++;
-        LOG_WRN(
-            "Unexpected key in Departures: %.*s\n",
-            DEPARTURE_TOK.end - DEPARTURE_TOK.start,
-            json_ptr + DEPARTURE_TOK.start
-        );
       }
 
-    check_validity:
-      if (departure_uniq && edt_in_future) {
-        valid_departure_count++;
-        break;
+      if (in_element) {
+        stop_parser_element_put(parser, c);
+      } else if (!parser->in_routes) {
+        stop_parser_scaffold_put(parser, c);
       }
+      continue;
     }
-    t += (departure_size * 2);
-    LOG_DBG("*********************(t: %d)********************\n", t);
-  }
-#ifdef CONFIG_DEBUG
-  for (int i = 0; i < CONFIG_ROUTE_MAX_DEPARTURES; i++) {
-    LOG_DBG(
-        "Uniq display text(s) %d: %s", i,
-        route_direction->departures[i].display_text
-    );
-  }
-#endif  // CONFIG_DEBUG
-  route_direction->departures_size = valid_departure_count;
-  return t;
-}
-#endif  // CONFIG_STOP_REQUEST_BUSTRACKER
 
-/** Iterates through the RouteDirections array objects to find desired values.
- */
-static int parse_route_directions(
-    const char *const json_ptr, int t, jsmntok_t tokens[],
-    size_t route_directions_count, Stop *stop, const int time_now
-) {
-  size_t valid_route_count = 0;
-
-  for (int rd_num = 0; rd_num < route_directions_count; rd_num++) {
-    RouteDirection *route_direction =
-        &stop->route_directions[valid_route_count];
-    /** The number of keys in the RouteDirection object.
-     *
-     *  tokens[t + 1] is a RouteDirection object,
-     *  so tokens[t + 1].size is the number of RouteDirection keys.
-     */
-    const size_t route_direction_size = tokens[t + 1].size;
-    LOG_DBG(
-        "=======Start Route Direction (t: %d, Route_Direction_Size: %d, "
-        "rd_num: %d)======",
-        t, route_direction_size * 2, rd_num
-    );
-    /* jsmntok::size is the number of keys but we're iterating over keys and
-     * values, so we need to double the size to get the true count.
-     */
-    for (int rdir = 0; rdir < (route_direction_size * 2); rdir++) {
-      if (jsoneq(json_ptr, &ROUTE_DIRECTION_TOK, "Direction")) {
-        rdir++;
-        route_direction->direction_code =
-            *(json_ptr + ROUTE_DIRECTION_TOK.start);
-        LOG_DBG("- Direction: %c", *(json_ptr + ROUTE_DIRECTION_TOK.start));
-      } else if (jsoneq(json_ptr, &ROUTE_DIRECTION_TOK, "IsDone")) {
-        rdir++;
-      } else if (jsoneq(json_ptr, &ROUTE_DIRECTION_TOK, "IsHeadway")) {
-        rdir++;
-      } else if (jsoneq(json_ptr, &ROUTE_DIRECTION_TOK, "RouteId")) {
-        rdir++;
-        route_direction->id = atoi(json_ptr + ROUTE_DIRECTION_TOK.start);
-        LOG_DBG("- RouteId: %d", atoi(json_ptr + ROUTE_DIRECTION_TOK.start));
-      } else if (jsoneq(json_ptr, &ROUTE_DIRECTION_TOK, "Departures")) {
-        rdir++;
-        if ((ROUTE_DIRECTION_TOK.type == JSMN_ARRAY) &&
-            (ROUTE_DIRECTION_TOK.size > 0)) {
-          t = parse_departures(
-              json_ptr, t, tokens, rdir, ROUTE_DIRECTION_TOK.size,
-              route_direction, time_now
-          );
-          valid_route_count++;
-        } else {
-          break;
+    switch (c) {
+      case '\t':
+      case '\r':
+      case '\n':
+      case ' ':
+        if (in_element) {
+          stop_parser_element_put(parser, c);
+        }
+        continue;
+      case '\"':
+        parser->in_string = true;
+        if ((parser->depth == parser->stop_depth) && parser->expect_key) {
+          /* The key starts after the opening quote */
+          parser->key_start = parser->scaffold_len + 1;
+          parser->key_end = -1;
         }
-      } else if (jsoneq(json_ptr, &ROUTE_DIRECTION_TOK, "HeadwayDepartures")) {
-        rdir++;
-        if ((ROUTE_DIRECTION_TOK.type == JSMN_ARRAY) &&
-            (ROUTE_DIRECTION_TOK.size > 0)) {
-          /* We don't care about this array but we do need to account for it's
-           * size */
-          t += (ROUTE_DIRECTION_TOK.size * 2) + 1;
+        break;
+      case ':':
+        if (parser->depth == parser->stop_depth) {
+          parser->expect_key = false;
+        }
+        break;
+      case ',':
+        if (parser->depth == parser->stop_depth) {
+          parser->expect_key = true;
         }
-      } else {
-        /* We don't care about other keys so skip their values */
-        rdir++;
-        LOG_WRN(
-            "Unexpected key in RouteDirections: %.*s\n",
-            ROUTE_DIRECTION_TOK.end - ROUTE_DIRECTION_TOK.start,
-            json_ptr + ROUTE_DIRECTION_TOK.start
-        );
+        break;
+      case '{':
+      case '[':
+        if (parser->in_routes && (parser->depth == parser->stop_depth + 1)) {
+          parser->element_len = 0;
+          parser->element_overflow = false;
+        }
+        parser->depth++;
+        if ((c == '{') && (parser->stop_depth == 0)) {
+          parser->stop_depth = parser->depth;
+          parser->expect_key = true;
+        } else if ((c == '[') && (parser->depth == parser->stop_depth + 1) &&
+                   (parser->key_start >= 0)) {
+          const json_field *field = &stop_schema.fields[json_key_classify(
+              &parser->scaffold[parser->key_start], parser->key_end - parser->key_start
+          )];
+          if (field->streamed) {
+            stop_parser_scaffold_put(parser, c);
+            parser->routes = field;
+            parser->in_routes = true;
+            continue;
+          }
+        }
+        break;
+      case '}':
+      case ']':
+        parser->depth--;
+        if (parser->in_routes) {
+          if (parser->depth == parser->stop_depth + 1) {
+            stop_parser_element_put(parser, c);
+            stop_parser_end_element(parser);
+            continue;
+          } else if (parser->depth == parser->stop_depth) {
+            parser->in_routes = false;
+          }
+        }
+        break;
+      default:
+        break;
+    }
+
+    if (parser->in_routes) {
+      if (parser->depth > parser->stop_depth + 1) {
+        stop_parser_element_put(parser, c);
       }
+    } else {
+      stop_parser_scaffold_put(parser, c);
     }
-    /* Increase t by an additional 1 to step into the next object */
-    t += (route_direction_size * 2) + 1;
-    LOG_DBG(
-        "==============================(t: %d, rd_num: "
-        "%d)========================\n",
-        t, rd_num
-    );
   }
-  stop->routes_size = valid_route_count;
-  return t;
+
+  parser->cycles += k_cycle_get_32() - start;
+  return 0;
 }
 
-/** Parses a JSON string with jsmn, then iterates through the jsmn key tokens
- *  to find desired values.
- *
- * TODO: Acount for size of *optional* arrays while iterating.
- */
-int parse_stop_json(
-    const char *const json_ptr, Stop *stop, unsigned int time_now
-) {
+/** Parses the stop object members once the whole body has been fed. */
+int stop_parser_finish(StopParser *parser) {
+  Stop *stop = parser->stop;
   jsmn_parser p;
 
-  /** The number of maximum possible tokens we expect in our JSON string + 1 for
-   * the \0 delimiter. */
-  jsmntok_t tokens[STOP_TOK_COUNT + 1];
+  /** The stop object members with the routes elements removed */
+  jsmntok_t tokens[STOP_SCAFFOLD_TOK_COUNT];
 
-  /** The jsmn token counter. */
-  int t;
   int ret;
   int err;
 
+  if (parser->err) {
+    LOG_ERR("Failed to parse JSON");
+    return parser->err;
+  }
+
+  if (parser->in_string || (parser->depth != 0)) {
+    (void)eval_jsmn_return(JSMN_ERROR_PART);
+    return 3;
+  }
+
   jsmn_init(&p);
 
   /** The number of tokens *allocated* from tokens array to parse the JSON
    * string */
   ret = jsmn_parse(
-      &p, json_ptr, strlen(json_ptr), tokens, sizeof(tokens) / sizeof(jsmntok_t)
+      &p, parser->scaffold, parser->scaffold_len, tokens, sizeof(tokens) / sizeof(jsmntok_t)
   );
 
   err = eval_jsmn_return(ret);
   if (err) {
     LOG_ERR("Failed to parse JSON");
+    LOG_DBG("Stop:\n%.*s", parser->scaffold_len, parser->scaffold);
     return err;
   }
 
-  LOG_DBG("Tokens allocated: %d/%d\n", ret, STOP_TOK_COUNT);
+  LOG_DBG("Stop tokens allocated: %d/%d\n", ret, STOP_SCAFFOLD_TOK_COUNT);
+  parser->stop_tokens = ret;
 
   if (ret < 2) {
     LOG_INF("No scheduled departures");
     return 5;
   }
 
-  /* Set the starting position for t */
-  switch (tokens[0].type) {
-    case JSMN_ARRAY:
-      /* If the root token is an array, we assume the next token is an object;
-       * t is set to 2 so we can start in the object.
-       */
-      t = 2;
-      break;
-    case JSMN_OBJECT:
-      /* If the root token an object t is set to 1 so we can start in the
-       * object. */
-      t = 1;
-      break;
-    default:
-      LOG_ERR("Top level token isn't an array or object.");
-      return EXIT_FAILURE;
+  /* If the root token is an array, we assume the first element is the stop
+   * object. */
+  const int stop_tok = (tokens[0].type == JSMN_ARRAY) ? 1 : 0;
+  if (tokens[stop_tok].type != JSMN_OBJECT) {
+    LOG_ERR("Top level token isn't an array or object.");
+    return EXIT_FAILURE;
   }
 
-  /* We want to loop over all the keys of the root object.
-   * We know the token after a key is a value so we skip that iteration.
+  /* The routes were filled as they arrived, only their empty array is left */
+  json_schema_walk(parser->scaffold, tokens, stop_tok, &stop_schema, stop, &parser->ctx);
+  if (parser->ctx.other_stop) {
+    return EXIT_FAILURE;
+  }
+  LOG_DBG("LastUpdated: %llu\n", stop->last_updated);
+
+  /*
+   * Picolibc strtoull is not behaving as expected, needs more investigation
+   *
+   * if (stop->last_updated < new_last_updated) {
+   * stop->last_updated = new_last_updated;
+   * } else {
+   * LOG_INF("StopDepartures not updated, skipping.");
+   * break;
+   * }
    */
-  while (t < ret) {
-    if (jsoneq(json_ptr, &tokens[t], "LastUpdated")) {
-      t++;
-      const char *const last_updated_string = json_ptr + tokens[t].start + 7;
-      LOG_DBG("LastUpdated: %lu\n", strtoul(last_updated_string, NULL, 10));
-      unsigned long new_last_updated = strtoul(last_updated_string, NULL, 10);
-      stop->last_updated = new_last_updated;
-
-      /*
-       * Picolibc strtoull is not behaving as expected, needs more investigation
-       *
-       * if (stop->last_updated < new_last_updated) {
-       * stop->last_updated = new_last_updated;
-       * } else {
-       * LOG_INF("StopDepartures not updated, skipping.");
-       * break;
-       * }
-       */
-
-    } else if (jsoneq(json_ptr, &tokens[t], "RouteDirections")) {
-      /* Increase t by an additional 1 to step into the array */
-      t++;
-      /* tokens[t] is the RouteDirections array in this case,
-       * so tokens[t].size is the number of RouteDirections
-       */
-      if (tokens[t].type == JSMN_ARRAY && tokens[t].size > 0) {
-        t = parse_route_directions(
-            json_ptr, t, tokens, tokens[t].size, stop, time_now
-        );
-      } else {
-        LOG_WRN("No RouteDirections to parse.");
-        break;
-      }
-    } else if (jsoneq(json_ptr, &tokens[t], "StopId")) {
-      t++;
-      /** TODO: Maybe verify the ID matches the one requested? Seems silly. */
-      LOG_DBG("StopId: %d\n", atoi(json_ptr + tokens[t].start));
-    } else {
-      t++;
-      LOG_WRN(
-          "Unexpected key in Stop: %.*s\n", tokens[t].end - tokens[t].start,
-          json_ptr + tokens[t].start
-      );
-    }
-    t++;
+
+  if (stop->routes_size == 0) {
+    LOG_WRN("No routes with departures.");
   }
+
   return EXIT_SUCCESS;
 }
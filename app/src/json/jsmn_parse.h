@@ -1,8 +1,92 @@
 #ifndef JSMN_PARSE_H
 #define JSMN_PARSE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "json/json_schema.h"
+#include "json/stop_schema.h"
 #include "stop.h"
 
-int parse_stop_json(
-    const char *const json_ptr, Stop *stop, unsigned int time_now
+/** Max size of the stop object with its routes elements removed. */
+#define STOP_JSON_SCAFFOLD_SIZE 256
+
+/** The root array, the stop object, its 3 keys and values. Routes elements
+ * are parsed separately so the array is always empty here. */
+#define STOP_SCAFFOLD_TOK_COUNT 16
+
+/** Resumable stop JSON parser state.
+ *
+ *  The response body is fed in whatever chunks recv() returns. Each element of
+ *  the stop_schema streamed routes array is buffered on its own and parsed into
+ *  the Stop as soon as it is complete, so only one route has to fit in memory
+ *  at a time.
+ */
+typedef struct StopParser {
+  Stop *stop;
+  StopSchemaCtx ctx;
+  /** Current nesting depth and the depth of the stop object */
+  int depth;
+  int stop_depth;
+  bool in_string;
+  bool escape;
+  bool expect_key;
+  bool in_routes;
+  /** Offsets of the last stop object key in scaffold */
+  int key_start;
+  int key_end;
+  int err;
+  /** The streamed routes field of stop_schema, once its key was seen */
+  const json_field *routes;
+  /** Protobuf wire format state of the GTFS-realtime splitter, see
+   *  proto/gtfs_rt.c */
+  uint8_t pb_state;
+  uint8_t pb_shift;
+  uint32_t pb_varint;
+  uint32_t pb_field;
+  size_t pb_left;
+  /** Buffer the current routes element is collected in */
+  char *element;
+  size_t element_size;
+  size_t element_len;
+  bool element_overflow;
+  size_t scaffold_len;
+  /** Cycles spent in stop_parser_feed(), not counting recv(), and the bytes
+   *  it was fed */
+  uint32_t cycles;
+  size_t bytes;
+  /** Tokens used by the stop object and by the largest route */
+  unsigned int stop_tokens;
+  unsigned int max_route_tokens;
+  /* Must stay last, stop_parser_init() doesn't clear it */
+  char scaffold[STOP_JSON_SCAFFOLD_SIZE];
+} StopParser;
+
+/** Resets the parser for a new response. The Stop is left untouched until
+ *  stop_parser_clear_stop(), so it survives a response without a body.
+ *
+ *  @param element_buf Buffer for a single routes element, it must
+ *  stay valid until stop_parser_finish() returns.
+ */
+void stop_parser_init(
+    StopParser *parser, Stop *stop, unsigned int time_now, char *element_buf,
+    size_t element_buf_size
 );
+
+/** Removes the Stop's routes and display texts before a new body is parsed
+ *  into it. */
+void stop_parser_clear_stop(StopParser *parser);
+
+/** Feeds a chunk of the response body to the parser.
+ *
+ *  @param user_data The StopParser, matches the http_body_cb_t signature.
+ */
+int stop_parser_feed(const char *data, size_t len, void *user_data);
+
+/** Parses the remaining stop object members after the last chunk.
+ *
+ *  @return 0 on success, the eval_jsmn_return() error, 1 if the feed is of
+ *  another stop, or 5 when no departures are scheduled.
+ */
+int stop_parser_finish(StopParser *parser);
 #endif
@@ -16,6 +16,30 @@ const int jsoneq(const char *const json_ptr, const jsmntok_t *tok, const char *c
   return 0;
 }
 
+enum json_key json_key_tok(const char *const json_ptr, const jsmntok_t *tok) {
+  if (tok->type != JSMN_STRING) {
+    return JSON_KEY_UNKNOWN;
+  }
+  return json_key_classify(json_ptr + tok->start, tok->end - tok->start);
+}
+
+unsigned long long json_date_ms(const char *const json_ptr, const jsmntok_t *tok) {
+  unsigned long long ms = 0;
+  int i = tok->start;
+
+  /* Skip the leading \/Date( if there is one */
+  while ((i < tok->end) && ((json_ptr[i] < '0') || (json_ptr[i] > '9'))) {
+    i++;
+  }
+
+  /* Parsed by hand, picolibc's strtoull isn't reliable for 13 digit values */
+  for (; (i < tok->end) && (json_ptr[i] >= '0') && (json_ptr[i] <= '9'); i++) {
+    ms = (ms * 10) + (json_ptr[i] - '0');
+  }
+
+  return ms;
+}
+
 const int eval_jsmn_return(const int ret) {
   switch (ret) {
     case JSMN_ERROR_NOMEM:
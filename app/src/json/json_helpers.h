@@ -8,9 +8,24 @@
 #define JSMN_HEADER
 
 #include "json/jsmn.h"
+#include "json_keys.h"
 
 /** Compares a string with a jsmn token value. */
 const int jsoneq(const char *const json_ptr, const jsmntok_t *tok, const char *const string);
 
+/** Classifies a jsmn key token, see json_keys.txt. */
+enum json_key json_key_tok(const char *const json_ptr, const jsmntok_t *tok);
+
+/** Returns the index of the token after tokens[t] and its whole subtree.
+ *
+ *  Works for any value, nested objects and arrays included, in constant
+ *  time using the jsmn next links.
+ */
+static inline int json_skip(const jsmntok_t tokens[], int t) { return tokens[t].next; }
+
+/** Returns the ms since the epoch from a "\/Date(1648627309163-0400)\/" or a
+ *  plain 1648627309163 token. */
+unsigned long long json_date_ms(const char *const json_ptr, const jsmntok_t *tok);
+
 const int eval_jsmn_return(const int ret);
 #endif
@@ -0,0 +1,120 @@
+/** @headerfile json_schema.h */
+#include "json/json_schema.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include "json/json_helpers.h"
+
+LOG_MODULE_REGISTER(json_schema);
+
+static void json_schema_walk_array(
+    const char *const json_ptr, const jsmntok_t tokens[], int arr, const json_field *field,
+    void *parent, void *ctx
+) {
+  unsigned int *count = (unsigned int *)((uint8_t *)parent + field->count_offset);
+
+  *count = 0;
+
+  /* Step into the array, then hop from one element to the next */
+  for (int i = 0, e = arr + 1; (i < tokens[arr].size) && (*count < field->max);
+       i++, e = json_skip(tokens, e)) {
+    (void)json_schema_walk_element(json_ptr, tokens, e, field, parent, ctx);
+  }
+}
+
+int json_schema_walk_element(
+    const char *const json_ptr, const jsmntok_t tokens[], int e, const json_field *field,
+    void *parent, void *ctx
+) {
+  unsigned int *count = (unsigned int *)((uint8_t *)parent + field->count_offset);
+  void *elem = (uint8_t *)parent + field->offset + (*count * field->size);
+
+  if (tokens[e].type != JSMN_OBJECT) {
+    LOG_WRN("%s isn't an object, skipping.", field->schema->name);
+    return 0;
+  }
+
+  (void)memset(elem, 0, field->size);
+  json_schema_walk(json_ptr, tokens, e, field->schema, elem, ctx);
+
+  if ((field->schema->accept != NULL) && !field->schema->accept(elem, parent, *count, ctx)) {
+    return 0;
+  }
+
+  (*count)++;
+  return 1;
+}
+
+void json_schema_walk(
+    const char *const json_ptr, const jsmntok_t tokens[], int obj, const json_schema *schema,
+    void *dest, void *ctx
+) {
+  /* Keys are at t and their values at t + 1. json_skip() jumps over each
+   * value, whatever it is, to land on the next key. */
+  int t = obj + 1;
+  for (int key = 0; key < tokens[obj].size; key++) {
+    const json_field *field = &schema->fields[json_key_tok(json_ptr, &tokens[t])];
+    const jsmntok_t *value = &tokens[t + 1];
+
+    if (field->type == 0) {
+      LOG_WRN(
+          "Unexpected key in %s: %.*s\n", schema->name, tokens[t].end - tokens[t].start,
+          json_ptr + tokens[t].start
+      );
+    } else if ((field->type & value->type) == 0) {
+      LOG_WRN(
+          "Unexpected value type for %s key %.*s\n", schema->name,
+          tokens[t].end - tokens[t].start, json_ptr + tokens[t].start
+      );
+    } else if (field->convert != NULL) {
+      field->convert(json_ptr, value, (uint8_t *)dest + field->offset, field->size, ctx);
+    } else if ((field->schema != NULL) && !field->streamed) {
+      json_schema_walk_array(json_ptr, tokens, t + 1, field, dest, ctx);
+    }
+
+    t = json_skip(tokens, t + 1);
+  }
+}
+
+void json_convert_int(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+) {
+  *(int *)dest = atoi(json_ptr + tok->start);
+}
+
+void json_convert_uint(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+) {
+  *(unsigned int *)dest = strtoul(json_ptr + tok->start, NULL, 10);
+}
+
+void json_convert_char(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+) {
+  *(char *)dest = (tok->end > tok->start) ? json_ptr[tok->start] : '\0';
+}
+
+void json_convert_string(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+) {
+  const size_t len = MIN((size_t)(tok->end - tok->start), size - 1);
+
+  (void)memcpy(dest, json_ptr + tok->start, len);
+  ((char *)dest)[len] = '\0';
+}
+
+void json_convert_date_s(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+) {
+  *(unsigned int *)dest = json_date_ms(json_ptr, tok) / 1000;
+}
+
+void json_convert_date_ms(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+) {
+  *(unsigned long long *)dest = json_date_ms(json_ptr, tok);
+}
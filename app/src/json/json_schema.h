@@ -0,0 +1,126 @@
+/** @file json_schema.h
+ *  @brief Table driven extraction of jsmn tokens into C structs.
+ *
+ *  A schema is a const table of fields indexed by enum json_key, so looking up
+ *  a key's field is a single array index. Each field names the jsmn token
+ *  types it accepts, where in the destination struct the value goes and the
+ *  converter that writes it. json_schema_walk() is the one loop that fills a
+ *  struct from any schema.
+ */
+
+#ifndef JSON_SCHEMA_H
+#define JSON_SCHEMA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define JSMN_HEADER
+
+#include "json/jsmn.h"
+#include "json_keys.h"
+
+/** Converts a value token and writes it to dest, which is size bytes. ctx is
+ *  the one passed to json_schema_walk(). */
+typedef void (*json_convert_t)(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+);
+
+typedef struct json_schema json_schema;
+
+typedef struct json_field {
+  /** Accepted jsmntype_t mask, 0 for keys that aren't in the schema */
+  int type;
+  /** Converter for scalar fields, NULL for arrays and ignored keys */
+  json_convert_t convert;
+  /** Offset of the destination member and its size, or element size */
+  size_t offset;
+  size_t size;
+  /** Element schema, capacity and unsigned int count member for arrays of
+   *  objects */
+  const json_schema *schema;
+  size_t max;
+  size_t count_offset;
+  /** The array is parsed element by element as it streams in, see
+   * StopParser, so the walker leaves it alone. */
+  bool streamed;
+} json_field;
+
+struct json_schema {
+  /** Object name used in logs */
+  const char *name;
+  const json_field *fields;
+  /** Called after an array element is filled, returning false drops it.
+   *  index is the element's position in parent. */
+  bool (*accept)(const void *obj, const void *parent, size_t index, void *ctx);
+};
+
+#define JSON_MEMBER_SIZE(_struct, _member) sizeof(((_struct *)0)->_member)
+
+/** A scalar field converted into _struct._member */
+#define JSON_FIELD(_key, _type, _struct, _member, _convert)                              \
+  [_key] = {                                                                             \
+      .type = (_type), .convert = (_convert), .offset = offsetof(_struct, _member),      \
+      .size = JSON_MEMBER_SIZE(_struct, _member)                                         \
+  }
+
+/** An array of objects filled into _struct._member[], counted in _count */
+#define JSON_FIELD_ARRAY(_key, _struct, _member, _count, _schema)                        \
+  [_key] = {                                                                             \
+      .type = JSMN_ARRAY, .offset = offsetof(_struct, _member),                          \
+      .size = JSON_MEMBER_SIZE(_struct, _member[0]), .schema = (_schema),                \
+      .max = JSON_MEMBER_SIZE(_struct, _member) / JSON_MEMBER_SIZE(_struct, _member[0]), \
+      .count_offset = offsetof(_struct, _count)                                          \
+  }
+
+/** Same as JSON_FIELD_ARRAY, but filled one element at a time by the caller */
+#define JSON_FIELD_STREAMED_ARRAY(_key, _struct, _member, _count, _schema)                \
+  [_key] = {                                                                             \
+      .type = JSMN_ARRAY, .offset = offsetof(_struct, _member),                          \
+      .size = JSON_MEMBER_SIZE(_struct, _member[0]), .schema = (_schema),                \
+      .max = JSON_MEMBER_SIZE(_struct, _member) / JSON_MEMBER_SIZE(_struct, _member[0]), \
+      .count_offset = offsetof(_struct, _count), .streamed = true                        \
+  }
+
+/** A key that is expected but not needed, its value is skipped silently */
+#define JSON_FIELD_IGNORE(_key) \
+  [_key] = {.type = JSMN_OBJECT | JSMN_ARRAY | JSMN_STRING | JSMN_PRIMITIVE}
+
+/** Fills dest from the object at tokens[obj] using schema. */
+void json_schema_walk(
+    const char *const json_ptr, const jsmntok_t tokens[], int obj, const json_schema *schema,
+    void *dest, void *ctx
+);
+
+/** Fills the next free element of the array field in parent from the object
+ *  at tokens[e], and counts it if the element schema accepts it.
+ *
+ *  @return 1 if the element was kept, otherwise 0.
+ */
+int json_schema_walk_element(
+    const char *const json_ptr, const jsmntok_t tokens[], int e, const json_field *field,
+    void *parent, void *ctx
+);
+
+/** Converters for JSON_FIELD */
+void json_convert_int(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+);
+void json_convert_uint(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+);
+void json_convert_char(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+);
+void json_convert_string(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+);
+/** "\/Date(1648627309163-0400)\/" to seconds (unsigned int) since the epoch */
+void json_convert_date_s(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+);
+/** "\/Date(1648627309163-0400)\/" to ms (unsigned long long) since the epoch */
+void json_convert_date_ms(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+);
+
+#endif  // JSON_SCHEMA_H
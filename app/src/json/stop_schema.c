@@ -0,0 +1,147 @@
+/** @headerfile stop_schema.h */
+#include "json/stop_schema.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "stop.h"
+#include "string_table.h"
+
+LOG_MODULE_REGISTER(stop_schema);
+
+void stop_schema_ctx_init(StopSchemaCtx *ctx, StringTable *texts, unsigned int time_now) {
+  (void)memset(ctx, 0, sizeof(*ctx));
+  ctx->time_now = time_now;
+  ctx->texts = texts;
+  ctx->route = 1;
+}
+
+/** Interns a display text, departures whose text doesn't fit keep the empty
+ *  text and are dropped. */
+static void convert_text(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+) {
+  StopSchemaCtx *stop_ctx = ctx;
+  const int id =
+      string_table_intern(stop_ctx->texts, json_ptr + tok->start, tok->end - tok->start);
+
+  *(string_id_t *)dest = (id < 0) ? STRING_ID_EMPTY : id;
+}
+
+/** Checks the stop ID of the feed is the one requested, dest is Stop.id. */
+static void convert_stop_id(
+    const char *const json_ptr, const jsmntok_t *tok, void *dest, size_t size, void *ctx
+) {
+  StopSchemaCtx *stop_ctx = ctx;
+  const char *id = *(const char *const *)dest;
+  const size_t len = tok->end - tok->start;
+
+  if ((strlen(id) != len) || (strncmp(json_ptr + tok->start, id, len) != 0)) {
+    LOG_ERR("Got the feed of stop %.*s instead of %s", (int)len, json_ptr + tok->start, id);
+    stop_ctx->other_stop = true;
+  }
+}
+
+bool stop_departure_accept(const void *obj, const void *parent, size_t index, void *ctx) {
+  const Departure *departure = obj;
+  StopSchemaCtx *stop_ctx = ctx;
+
+  if ((departure->text == STRING_ID_EMPTY) || (departure->etd <= stop_ctx->time_now) ||
+      (stop_ctx->text_route[departure->text] == stop_ctx->route)) {
+    return false;
+  }
+
+  stop_ctx->text_route[departure->text] = stop_ctx->route;
+  return true;
+}
+
+bool stop_route_accept(const void *obj, const void *parent, size_t index, void *ctx) {
+  StopSchemaCtx *stop_ctx = ctx;
+
+  /* Called after every route, so the next one starts with no texts shown */
+  stop_ctx->route++;
+  return ((const RouteDirection *)obj)->departures_size > 0;
+}
+
+#ifdef CONFIG_STOP_REQUEST_BUSTRACKER
+/* BusTracker InfoPoint SignageStopDepartures */
+static const json_field departure_fields[JSON_KEY_COUNT] = {
+    JSON_FIELD(JSON_KEY_DISPLAY_TEXT, JSMN_STRING, Departure, text, convert_text),
+    /* EDT ex: /Date(1648627309163-0400)\, the timezone isn't needed */
+    JSON_FIELD(JSON_KEY_EDT, JSMN_STRING, Departure, etd, json_convert_date_s),
+    JSON_FIELD_IGNORE(JSON_KEY_ETA),
+    JSON_FIELD_IGNORE(JSON_KEY_GOOGLE_TRIP_ID),
+    JSON_FIELD_IGNORE(JSON_KEY_LAST_UPDATED),
+    JSON_FIELD_IGNORE(JSON_KEY_SDT),
+    JSON_FIELD_IGNORE(JSON_KEY_STA),
+    JSON_FIELD_IGNORE(JSON_KEY_VEHICLE_ID),
+};
+
+static const json_schema departure_schema = {
+    .name = "Departures", .fields = departure_fields, .accept = stop_departure_accept
+};
+
+static const json_field route_fields[JSON_KEY_COUNT] = {
+    JSON_FIELD(JSON_KEY_DIRECTION, JSMN_STRING, RouteDirection, direction_code, json_convert_char),
+    JSON_FIELD(JSON_KEY_ROUTE_ID, JSMN_PRIMITIVE, RouteDirection, id, json_convert_int),
+    JSON_FIELD_ARRAY(
+        JSON_KEY_DEPARTURES, RouteDirection, departures, departures_size, &departure_schema
+    ),
+    JSON_FIELD_IGNORE(JSON_KEY_IS_DONE),
+    JSON_FIELD_IGNORE(JSON_KEY_IS_HEADWAY),
+    JSON_FIELD_IGNORE(JSON_KEY_HEADWAY_DEPARTURES),
+};
+
+static const json_schema route_schema = {
+    .name = "RouteDirections", .fields = route_fields, .accept = stop_route_accept
+};
+
+static const json_field stop_fields[JSON_KEY_COUNT] = {
+    JSON_FIELD(JSON_KEY_LAST_UPDATED, JSMN_STRING, Stop, last_updated, json_convert_date_ms),
+    JSON_FIELD_STREAMED_ARRAY(
+        JSON_KEY_ROUTE_DIRECTIONS, Stop, route_directions, routes_size, &route_schema
+    ),
+    JSON_FIELD(JSON_KEY_STOP_ID, JSMN_PRIMITIVE | JSMN_STRING, Stop, id, convert_stop_id),
+};
+#endif  // CONFIG_STOP_REQUEST_BUSTRACKER
+
+#ifdef CONFIG_STOP_REQUEST_JES
+/* JES stop feed, a trimmed down version of the BusTracker feed:
+ * {"updated":1648627309163,"stop":73,"routes":[{"id":31,"dir":"N",
+ *  "deps":[{"text":"Amherst","etd":1648627309}]}]}
+ * updated is in ms and etd in seconds since the epoch.
+ */
+static const json_field departure_fields[JSON_KEY_COUNT] = {
+    JSON_FIELD(JSON_KEY_TEXT, JSMN_STRING, Departure, text, convert_text),
+    JSON_FIELD(JSON_KEY_ETD, JSMN_PRIMITIVE, Departure, etd, json_convert_uint),
+};
+
+static const json_schema departure_schema = {
+    .name = "deps", .fields = departure_fields, .accept = stop_departure_accept
+};
+
+static const json_field route_fields[JSON_KEY_COUNT] = {
+    JSON_FIELD(JSON_KEY_DIR, JSMN_STRING, RouteDirection, direction_code, json_convert_char),
+    JSON_FIELD(JSON_KEY_ID, JSMN_PRIMITIVE, RouteDirection, id, json_convert_int),
+    JSON_FIELD_ARRAY(JSON_KEY_DEPS, RouteDirection, departures, departures_size, &departure_schema),
+};
+
+static const json_schema route_schema = {
+    .name = "routes", .fields = route_fields, .accept = stop_route_accept
+};
+
+static const json_field stop_fields[JSON_KEY_COUNT] = {
+    JSON_FIELD(JSON_KEY_UPDATED, JSMN_PRIMITIVE, Stop, last_updated, json_convert_date_ms),
+    JSON_FIELD_STREAMED_ARRAY(JSON_KEY_ROUTES, Stop, route_directions, routes_size, &route_schema),
+    JSON_FIELD(JSON_KEY_STOP, JSMN_PRIMITIVE | JSMN_STRING, Stop, id, convert_stop_id),
+};
+#endif  // CONFIG_STOP_REQUEST_JES
+
+#if !defined(CONFIG_STOP_REQUEST_BUSTRACKER) && !defined(CONFIG_STOP_REQUEST_JES)
+/* The feed isn't JSON, no key is expected */
+static const json_field stop_fields[JSON_KEY_COUNT] = {0};
+#endif
+
+const json_schema stop_schema = {.name = "Stop", .fields = stop_fields};
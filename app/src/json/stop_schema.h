@@ -0,0 +1,47 @@
+/** @file stop_schema.h
+ *  @brief json_schema tables mapping the stop feeds onto stop.h.
+ */
+
+#ifndef STOP_SCHEMA_H
+#define STOP_SCHEMA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "json/json_schema.h"
+#include "string_table.h"
+
+/** State shared by the stop schema converters and accept hooks, passed as
+ *  the json_schema_walk() ctx. */
+typedef struct StopSchemaCtx {
+  /** Departures at or before this time, in seconds since the epoch, are dropped */
+  unsigned int time_now;
+  StringTable *texts;
+  /** Serial of the route being parsed and of the last route to show each
+   *  text, so repeated texts are found without searching the route. */
+  uint16_t route;
+  uint16_t text_route[CONFIG_STOP_MAX_TEXTS];
+  /** Set if the feed is of another stop than Stop.id */
+  bool other_stop;
+} StopSchemaCtx;
+
+/** @brief Resets ctx for a new response, texts itself is left as is. */
+void stop_schema_ctx_init(StopSchemaCtx *ctx, StringTable *texts, unsigned int time_now);
+
+/** @brief Keeps departures that haven't left yet and whose display text is
+ *  unique for the route. The accept hook of the departure schemas.
+ */
+bool stop_departure_accept(const void *obj, const void *parent, size_t index, void *ctx);
+
+/** @brief Drops routes without any upcoming departures, which would only take
+ *  up a slot. The accept hook of the route schemas, call it after every route.
+ */
+bool stop_route_accept(const void *obj, const void *parent, size_t index, void *ctx);
+
+/** Schema of the stop object for the feed selected by STOP_REQUEST_FEED.
+ *  Its one streamed array field holds the routes.
+ */
+extern const json_schema stop_schema;
+
+#endif  // STOP_SCHEMA_H
@@ -198,7 +198,30 @@ int main(void) {
   );
   LOG_INF("update_stop_timer started");
 
+  /* The stop is refreshed on the HTTP work queue, so a slow request doesn't
+   * hold up the RTC sync. update_stop_sem is last so it can be left out while
+   * a refresh is running. */
+  struct k_poll_event events[] = {
+      K_POLL_EVENT_STATIC_INITIALIZER(
+          K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &update_stop_signal, 0
+      ),
+      K_POLL_EVENT_STATIC_INITIALIZER(
+          K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY, &rtc_sync_sem, 0
+      ),
+      K_POLL_EVENT_STATIC_INITIALIZER(
+          K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY, &update_stop_sem, 0
+      ),
+  };
+  bool updating = false;
+  int failures = 0;
+  unsigned int signaled;
+
   while (1) {
+    (void)k_poll(events, updating ? (ARRAY_SIZE(events) - 1) : ARRAY_SIZE(events), K_FOREVER);
+    for (size_t i = 0; i < ARRAY_SIZE(events); i++) {
+      events[i].state = K_POLL_STATE_NOT_READY;
+    }
+
     if (k_sem_take(&rtc_sync_sem, K_NO_WAIT) == 0) {
       ret = set_rtc_time();
       if (ret) {
@@ -207,42 +230,68 @@ int main(void) {
       }
     }
 
-    if (k_sem_take(&update_stop_sem, K_NO_WAIT) == 0) {
-      /* A returned 2 corresponds to a successful response with no scheduled
-       * departures.
-       */
-#ifdef CONFIG_LIGHT_SENSOR
-      ret = update_stop();
-      if (ret == 0) {
-        lux = get_lux();
-        if (lux < 0) {
-          goto reset;
-        }
-      } else if (ret == 2) {
-        lux = 0xFF;
-      } else {
+    if (!updating && (k_sem_take(&update_stop_sem, K_NO_WAIT) == 0)) {
+      ret = update_stop_submit();
+      if (ret < 0) {
+        LOG_ERR("Failed to submit stop update. Err: %d", ret);
         goto reset;
       }
+      updating = true;
+    }
 
-      ret = pwm_leds_set((uint32_t)lux);
-      if (ret) {
-        goto reset;
-      }
-#else
-      ret = update_stop();
-      if (ret && (ret != 2)) {
+    k_poll_signal_check(&update_stop_signal, &signaled, &ret);
+    if (!signaled) {
+      continue;
+    }
+    k_poll_signal_reset(&update_stop_signal);
+    updating = false;
+    /* Drop a refresh that came due while this one ran */
+    k_sem_reset(&update_stop_sem);
+
+    /* A returned 3 corresponds to a failed or timed out request, the last
+     * departures are still shown so only a run of them resets the board.
+     */
+    if (ret == 3) {
+      failures++;
+      if (failures >= CONFIG_UPDATE_STOP_MAX_FAILURES) {
+        LOG_ERR("Stop update failed %d times in a row.", failures);
         goto reset;
       }
-#endif  // CONFIG_LIGHT_SENSOR
+      LOG_WRN("Stop update failed, %d in a row.", failures);
+    } else {
+      failures = 0;
+    }
 
-      ret = wdt_feed(wdt, wdt_channel_id);
-      if (ret) {
-        LOG_ERR("Failed to feed watchdog. Err: %d", ret);
+    /* A returned 2 corresponds to a successful response with no scheduled
+     * departures.
+     */
+#ifdef CONFIG_LIGHT_SENSOR
+    if ((ret == 0) || (ret == 3)) {
+      lux = get_lux();
+      if (lux < 0) {
         goto reset;
       }
+    } else if (ret == 2) {
+      lux = 0xFF;
+    } else {
+      goto reset;
+    }
+
+    ret = pwm_leds_set((uint32_t)lux);
+    if (ret) {
+      goto reset;
+    }
+#else
+    if (ret && (ret != 2) && (ret != 3)) {
+      goto reset;
     }
+#endif  // CONFIG_LIGHT_SENSOR
 
-    k_cpu_idle();
+    ret = wdt_feed(wdt, wdt_channel_id);
+    if (ret) {
+      LOG_ERR("Failed to feed watchdog. Err: %d", ret);
+      goto reset;
+    }
   }
 
 reset:
@@ -1,15 +1,29 @@
 /** @headerfile custom_http_client.h */
 #include "custom_http_client.h"
 
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <zephyr/app_version.h>
+#include <zephyr/init.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/net/socket.h>
 #include <zephyr/net/tls_credentials.h>
 #include <zephyr/storage/stream_flash.h>
 
+#include "arena.h"
+#include "net/dns_cache.h"
+#include "net/http_location.h"
+#include "net/http_stats.h"
+#include "net/redirect_cache.h"
+#ifdef CONFIG_HTTP_INFLATE
+#include "net/inflate.h"
+#endif  // CONFIG_HTTP_INFLATE
 #include "net/lte_manager.h"
 #include "watchdog_app.h"
 
@@ -46,26 +60,25 @@ int tls_setup(int fd, char *hostname, sec_tag_t sec_tag) {
     return err;
   }
 
-  return EXIT_SUCCESS;
-}
-
-static int parse_status(char *headers_buf) {
-  char *ptr;
-  int code;
+#ifdef CONFIG_HTTP_TLS_SESSION_CACHE
+  /* Resume the last session with the server instead of a full handshake,
+   * a server that no longer knows the session falls back to one */
+  int session_cache = TLS_SESSION_CACHE_ENABLED;
 
-  ptr = strstr(headers_buf, "HTTP");
-  if (ptr == NULL) {
-    LOG_ERR("Missing HTTP status line");
-    return HTTP_NULL;
+  err = setsockopt(fd, SOL_TLS, TLS_SESSION_CACHE, &session_cache, sizeof(session_cache));
+  if (err) {
+    LOG_WRN("Failed to enable TLS session cache, %s", strerror(errno));
   }
+#endif  // CONFIG_HTTP_TLS_SESSION_CACHE
 
-  ptr = strstr(headers_buf, " ");
-  if (ptr == NULL) {
-    LOG_ERR("Improperly formatted HTTP status line");
-    return HTTP_NULL;
-  }
+  return EXIT_SUCCESS;
+}
 
-  code = atoi(ptr);
+static int parse_status(int code) {
+  if (code == 304) {
+    LOG_INF("Not modified response code: %d", code);
+    return HTTP_NOT_MODIFIED;
+  }
 
   switch (code) {
     case 100 ... 199:
@@ -89,163 +102,860 @@ static int parse_status(char *headers_buf) {
   }
 }
 
-static int parse_headers(int *sock, char *headers_buf, int headers_buf_size) {
-  int state = 0;
-  int bytes;
-  int status;
-  size_t headers_size = 0;
-  size_t headers_offset = 0;
+#define HEADER_NAME(name) {name, sizeof(name) - 1}
+
+/** Names of the headers in HttpHeaders.values, matched ignoring case */
+static const struct {
+  const char *name;
+  size_t len;
+} header_names[HTTP_HEADER_COUNT] = {
+    [HTTP_HEADER_CONTENT_LENGTH] = HEADER_NAME("Content-Length"),
+    [HTTP_HEADER_TRANSFER_ENCODING] = HEADER_NAME("Transfer-Encoding"),
+    [HTTP_HEADER_CONTENT_ENCODING] = HEADER_NAME("Content-Encoding"),
+    [HTTP_HEADER_CONNECTION] = HEADER_NAME("Connection"),
+    [HTTP_HEADER_LOCATION] = HEADER_NAME("Location"),
+    [HTTP_HEADER_ETAG] = HEADER_NAME("ETag"),
+    [HTTP_HEADER_LAST_MODIFIED] = HEADER_NAME("Last-Modified"),
+    [HTTP_HEADER_CACHE_CONTROL] = HEADER_NAME("Cache-Control"),
+    [HTTP_HEADER_AGE] = HEADER_NAME("Age"),
+    [HTTP_HEADER_DATE] = HEADER_NAME("Date"),
+    [HTTP_HEADER_SHA256] = HEADER_NAME("sha-256"),
+};
+
+/** Adds a header line, without its line ending, to the index. */
+static void index_header(HttpHeaders *headers, char *line) {
+  char *value = strchr(line, ':');
+
+  LOG_DBG("%s", line);
+
+  if (value == NULL) {
+    return;
+  }
 
-  do {
-    bytes = recv(*sock, &headers_buf[headers_offset], 1, 0);
-    if (bytes < 0) {
-      LOG_ERR("recv() headers failed, %s", strerror(errno));
-      return bytes;
+  const size_t name_len = value - line;
+
+  for (size_t i = 0; i < HTTP_HEADER_COUNT; i++) {
+    if ((name_len == header_names[i].len) &&
+        (strncasecmp(line, header_names[i].name, name_len) == 0)) {
+      value++;
+      while (*value == ' ') {
+        value++;
+      }
+      headers->values[i] = value;
+      return;
     }
+  }
+}
 
-    if ((state == 0 || state == 2) && headers_buf[headers_offset] == '\r') {
-      state++;
-    } else if (state == 1 && headers_buf[headers_offset] == '\n') {
-      state++;
-    } else if (state == 3) {
-      headers_size = headers_offset;
-      LOG_DBG("Received Headers. Size: %d bytes", headers_offset);
-
-      headers_buf[headers_offset + 1] = '\0';
-
-      status = parse_status(headers_buf);
-      switch (status) {
-        case HTTP_REDIRECT:
-          return -2;
-        case HTTP_CLIENT_ERROR:
-          return -3;
-        case HTTP_SERVER_ERROR:
-          return -4;
-        case HTTP_NULL:
-          return -5;
-        default:
-          break;
+/** Waits until sock is ready for events, or deadline passes.
+ *
+ *  @param phase What is being waited for, for the log.
+ *  @return 0 once ready, -8 if the deadline passed or -1 if poll() failed.
+ */
+static int wait_socket(int sock, short events, int64_t deadline, const char *phase) {
+  struct pollfd fd = {.fd = sock, .events = events};
+  const int64_t left = deadline - k_uptime_get();
+  int rc = 0;
+
+  if (left > 0) {
+    rc = poll(&fd, 1, (int)left);
+    if (rc < 0) {
+      LOG_ERR("poll() failed, %s", strerror(errno));
+      return -1;
+    }
+  }
+
+  if (rc == 0) {
+    LOG_ERR("Timed out waiting for the %s", phase);
+    return -8;
+  }
+  return 0;
+}
+
+/** Reads the response headers into headers_buf, as many bytes per recv() as
+ *  fit, and indexes each line as soon as it is complete. Lines are
+ *  terminated in place so the indexed values are plain strings. All of the
+ *  headers must arrive before deadline.
+ *
+ *  @return The size of the headers including the empty line ending them, 0
+ *  if the connection closed first, -5 if they don't fit headers_buf, -8 on
+ *  timeout or another negative error. Body bytes received along with the
+ *  headers are left in headers->body.
+ */
+static int read_headers(
+    int sock, char *headers_buf, int headers_buf_size, HttpHeaders *headers, int64_t deadline
+) {
+  int bytes;
+  char *end;
+  /** Bytes received, the start of the current line and where the search for
+   *  its end resumes */
+  size_t len = 0;
+  size_t line = 0;
+  size_t scan = 0;
+
+  (void)memset(headers, 0, sizeof(*headers));
+
+  while (true) {
+    end = memchr(&headers_buf[scan], '\n', len - scan);
+    if (end == NULL) {
+      scan = len;
+      if (len == headers_buf_size) {
+        LOG_ERR("Response headers larger than %d bytes", headers_buf_size);
+        return -5;
+      }
+
+      bytes = wait_socket(sock, POLLIN, deadline, "response headers");
+      if (bytes) {
+        return bytes;
       }
+
+      bytes = recv(sock, &headers_buf[len], headers_buf_size - len, 0);
+      if ((bytes < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+        continue;
+      } else if (bytes < 0) {
+        LOG_ERR("recv() headers failed, %s", strerror(errno));
+        return bytes;
+      } else if (bytes == 0) {
+        return 0;
+      }
+      http_stats_bytes(bytes);
+      len += bytes;
+      continue;
+    }
+
+    if ((end > &headers_buf[line]) && (end[-1] == '\r')) {
+      end[-1] = '\0';
+    }
+    *end = '\0';
+    scan = (end - headers_buf) + 1;
+
+    if (headers_buf[line] == '\0') {
+      /* The empty line ending the headers */
       break;
+    } else if (line == 0) {
+      /* "HTTP/1.1 200 OK", only HTTP/1.1 keeps the connection by default */
+      const char *code = strchr(headers_buf, ' ');
+      headers->status = (code == NULL) ? 0 : atoi(code);
+      headers->persistent = (strncmp(headers_buf, "HTTP/1.1", 8) == 0);
+      LOG_DBG("%s", headers_buf);
     } else {
-      state = 0;
+      index_header(headers, &headers_buf[line]);
     }
-    headers_offset += bytes;
-  } while (bytes != 0);
+    line = scan;
+  }
+
+  if ((headers->values[HTTP_HEADER_CONNECTION] != NULL) &&
+      (strncasecmp(headers->values[HTTP_HEADER_CONNECTION], "close", 5) == 0)) {
+    headers->persistent = false;
+  }
+
+  headers->body = &headers_buf[scan];
+  headers->body_len = len - scan;
+
+  LOG_DBG("Received Headers. Size: %d bytes", scan);
+  return scan;
+}
+
+/** Copies a header value into dest, which is left as is if the header is
+ *  missing or too long. */
+static bool copy_header(const HttpHeaders *headers, int header, char *dest, size_t size) {
+  const char *value = headers->values[header];
+
+  if (value == NULL) {
+    return false;
+  }
+
+  const size_t len = strlen(value);
+  if (len >= size) {
+    LOG_WRN("%s header longer than %d bytes, ignoring it", header_names[header].name, size - 1);
+    return false;
+  }
+
+  (void)memcpy(dest, value, len + 1);
+  return true;
+}
+
+void http_cache_clear(HttpCache *cache) {
+  cache->etag[0] = '\0';
+  cache->last_modified[0] = '\0';
+  cache->expires = 0;
+}
+
+/** Keeps the validators and max-age of a 2xx or 304 response. A 304 only
+ *  replaces the validators it carries. */
+static void http_cache_update(HttpCache *cache, const HttpHeaders *headers, bool not_modified) {
+  const char *cache_control = headers->values[HTTP_HEADER_CACHE_CONTROL];
+  const char *ptr;
+  long max_age;
+
+  if (!not_modified) {
+    http_cache_clear(cache);
+  }
+  cache->expires = 0;
+
+  (void)copy_header(headers, HTTP_HEADER_ETAG, cache->etag, sizeof(cache->etag));
+  (void)copy_header(
+      headers, HTTP_HEADER_LAST_MODIFIED, cache->last_modified, sizeof(cache->last_modified)
+  );
+
+  if (cache_control == NULL) {
+    return;
+  }
+
+  if (strstr(cache_control, "no-store") != NULL) {
+    http_cache_clear(cache);
+    return;
+  }
+
+  ptr = strstr(cache_control, "max-age=");
+  if ((ptr == NULL) || (strstr(cache_control, "no-cache") != NULL)) {
+    return;
+  }
+
+  max_age = atol(ptr + 8);
+
+  /* Time the response already spent in a proxy cache counts against it */
+  ptr = headers->values[HTTP_HEADER_AGE];
+  if (ptr != NULL) {
+    max_age -= atol(ptr);
+  }
+
+  if (max_age > 0) {
+    cache->expires = k_uptime_get() + ((int64_t)max_age * MSEC_PER_SEC);
+    LOG_DBG("Response fresh for %ld s", max_age);
+  }
+}
+
+static int parse_headers(
+    int *sock, char *headers_buf, int headers_buf_size, HttpHeaders *headers, HttpCache *cache,
+    int64_t deadline
+) {
+  int headers_size = read_headers(*sock, headers_buf, headers_buf_size, headers, deadline);
+
+  if (headers_size <= 0) {
+    return headers_size;
+  }
+
+  switch (parse_status(headers->status)) {
+    case HTTP_SUCCESS:
+      if (cache != NULL) {
+        http_cache_update(cache, headers, false);
+      }
+      break;
+    case HTTP_NOT_MODIFIED:
+      if (cache != NULL) {
+        http_cache_update(cache, headers, true);
+      }
+      return -7;
+    case HTTP_REDIRECT:
+      return -2;
+    case HTTP_CLIENT_ERROR:
+      return -3;
+    case HTTP_SERVER_ERROR:
+      return -4;
+    case HTTP_NULL:
+      return -5;
+    default:
+      break;
+  }
 
   return headers_size;
 }
 
-static long parse_response(
-    int *sock, char *recv_body_buf, int recv_body_buf_size, long offset, char *headers_buf,
-    int headers_buf_size, _Bool write_nvs
+enum chunk_state {
+  /** The body isn't chunked */
+  CHUNK_NONE = 0,
+  /** Hex digits of the chunk size */
+  CHUNK_SIZE,
+  /** Chunk extensions up to the end of the size line */
+  CHUNK_EXT,
+  CHUNK_DATA,
+  /** The line ending after the chunk data */
+  CHUNK_DATA_END,
+  /** Start of a trailer line, or of the empty line ending the body */
+  CHUNK_TRAILER,
+  CHUNK_TRAILER_LINE,
+  CHUNK_DONE,
+};
+
+/** How the end of the body is found */
+typedef struct BodyFraming {
+  enum chunk_state chunk;
+  /** Bytes left of the current chunk or of Content-Length, -1 until the
+   *  server closes the connection */
+  long remaining;
+} BodyFraming;
+
+/** Whether the whole body has been received */
+static bool body_complete(const BodyFraming *framing) {
+  return (framing->chunk == CHUNK_NONE) ? (framing->remaining == 0)
+                                        : (framing->chunk == CHUNK_DONE);
+}
+
+/** Removes the Transfer-Encoding: chunked framing from data in place.
+ *
+ *  @return The number of body bytes left at the start of data, or -1 if the
+ *  framing is malformed.
+ */
+static long dechunk(BodyFraming *framing, char *data, size_t len) {
+  size_t out = 0;
+  size_t i = 0;
+
+  while ((i < len) && (framing->chunk != CHUNK_DONE)) {
+    if (framing->chunk == CHUNK_DATA) {
+      const size_t run = MIN(framing->remaining, len - i);
+
+      if (out != i) {
+        (void)memmove(&data[out], &data[i], run);
+      }
+      out += run;
+      i += run;
+      framing->remaining -= run;
+      if (framing->remaining == 0) {
+        framing->chunk = CHUNK_DATA_END;
+      }
+      continue;
+    }
+
+    const char c = data[i++];
+
+    switch (framing->chunk) {
+      case CHUNK_SIZE:
+      case CHUNK_EXT:
+        if (c == '\n') {
+          framing->chunk = (framing->remaining == 0) ? CHUNK_TRAILER : CHUNK_DATA;
+        } else if ((framing->chunk == CHUNK_SIZE) && isxdigit((unsigned char)c)) {
+          if (framing->remaining > (LONG_MAX >> 4)) {
+            LOG_ERR("Chunk size too large");
+            return -1;
+          }
+          framing->remaining = (framing->remaining << 4) |
+                               (isdigit((unsigned char)c) ? (c - '0') : ((c | 0x20) - 'a' + 10));
+        } else {
+          framing->chunk = CHUNK_EXT;
+        }
+        break;
+      case CHUNK_DATA_END:
+        if (c == '\n') {
+          framing->chunk = CHUNK_SIZE;
+        } else if (c != '\r') {
+          LOG_ERR("Missing line ending after chunk data");
+          return -1;
+        }
+        break;
+      case CHUNK_TRAILER:
+        if (c == '\n') {
+          framing->chunk = CHUNK_DONE;
+        } else if (c != '\r') {
+          framing->chunk = CHUNK_TRAILER_LINE;
+        }
+        break;
+      case CHUNK_TRAILER_LINE:
+        if (c == '\n') {
+          framing->chunk = CHUNK_TRAILER;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (i < len) {
+    LOG_WRN("Dropping %d bytes past the last chunk", len - i);
+  }
+
+  return out;
+}
+
+/** Removes the framing from part of the body and passes what is left on to
+ *  body_cb.
+ *
+ *  @return The number of body bytes passed on, -5 if the chunked framing is
+ *  malformed or -6 if body_cb failed.
+ */
+static long body_received(
+    BodyFraming *framing, char *data, size_t len, http_body_cb_t body_cb, void *user_data
+) {
+  long body_len = len;
+  int rc;
+
+  if (framing->chunk != CHUNK_NONE) {
+    body_len = dechunk(framing, data, len);
+    if (body_len < 0) {
+      return -5;
+    }
+  } else if (framing->remaining >= 0) {
+    if (body_len > framing->remaining) {
+      LOG_WRN("Dropping %ld bytes past Content-Length", body_len - framing->remaining);
+      body_len = framing->remaining;
+    }
+    framing->remaining -= body_len;
+  }
+
+  if (body_len == 0) {
+    return 0;
+  }
+
+  rc = body_cb(data, body_len, user_data);
+  if (rc) {
+    LOG_ERR("Response body callback failed. Err: %d", rc);
+    return -6;
+  }
+
+  return body_len;
+}
+
+/** Receives the rest of the body after the part that arrived with the headers.
+ *  Each part must arrive within CONFIG_HTTP_BODY_TIMEOUT_MS of the last one.
+ *
+ *  @param offset Number of body bytes received so far, updated as more arrive.
+ *  @return 0 once the body is complete or the server closed the connection,
+ *  -10 if the modem's secure socket buffer limit was reached and the rest
+ *  must be requested with a range from offset, -8 if the body stalled or the
+ *  connection closed before its end, or another negative error.
+ */
+static long receive_body(
+    int *sock, char *recv_buf, int recv_buf_size, BodyFraming *framing, http_body_cb_t body_cb,
+    void *user_data, long *offset
 ) {
   int bytes;
+  size_t len;
+  long body_len;
 
-  int headers_size = parse_headers(sock, headers_buf, headers_buf_size);
+  while (!body_complete(framing)) {
+    len = ((framing->chunk != CHUNK_NONE) || (framing->remaining < 0))
+              ? recv_buf_size
+              : MIN(framing->remaining, recv_buf_size);
+
+    bytes = wait_socket(*sock, POLLIN, k_uptime_get() + CONFIG_HTTP_BODY_TIMEOUT_MS, "body");
+    if (bytes) {
+      return bytes;
+    }
+
+    bytes = recv(*sock, recv_buf, len, 0);
+    if ((bytes < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      continue;
+    } else if (bytes < 0) {
+      if (errno == EMSGSIZE) {
+        LOG_WRN(
+            "recv() returned EMSGSIZE. Modem's secure socket buffer limit "
+            "reached.\nRetrying with new socket, Range: %ld-",
+            *offset
+        );
+        return -10;
+      }
+      LOG_ERR("recv() body failed, %s", strerror(errno));
+      return bytes;
+    } else if (bytes == 0) {
+      /* A framed body cut short is as incomplete as a stalled one */
+      if (framing->chunk != CHUNK_NONE) {
+        LOG_ERR("Connection closed before the last chunk");
+        return -8;
+      } else if (framing->remaining > 0) {
+        LOG_ERR("Connection closed %ld bytes before the end of the body", framing->remaining);
+        return -8;
+      }
+      break;
+    }
+    LOG_DBG("recv bytes: %d", bytes);
+    http_stats_bytes(bytes);
+
+    body_len = body_received(framing, recv_buf, bytes, body_cb, user_data);
+    if (body_len < 0) {
+      return body_len;
+    }
+    *offset += body_len;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+#ifdef CONFIG_HTTP_INFLATE
+/** Set once a response needed a larger window than
+ *  CONFIG_HTTP_INFLATE_WINDOW_SIZE, compression is no longer requested */
+static bool inflate_disabled;
+
+/** Puts an Inflater between the client and body_cb if the body is
+ *  compressed. The Inflater and its window come from the scratch arena.
+ *
+ *  @return 0, or -5 if the encoding isn't supported or doesn't fit the arena.
+ */
+static int inflate_setup(
+    const HttpHeaders *headers, Inflater **inflater, http_body_cb_t *body_cb, void **user_data
+) {
+  const char *encoding = headers->values[HTTP_HEADER_CONTENT_ENCODING];
+  enum inflate_format format;
+  uint8_t *window;
+
+  *inflater = NULL;
+
+  if ((encoding == NULL) || (strcasecmp(encoding, "identity") == 0)) {
+    return 0;
+  } else if ((strcasecmp(encoding, "gzip") == 0) || (strcasecmp(encoding, "x-gzip") == 0)) {
+    format = INFLATE_GZIP;
+  } else if (strcasecmp(encoding, "deflate") == 0) {
+    format = INFLATE_DEFLATE;
+  } else {
+    LOG_ERR("Unsupported Content-Encoding: %s", encoding);
+    return -5;
+  }
+
+  *inflater = arena_alloc(sizeof(**inflater));
+  window = arena_alloc(CONFIG_HTTP_INFLATE_WINDOW_SIZE);
+  if ((*inflater == NULL) || (window == NULL)) {
+    LOG_ERR("Scratch arena too small to inflate the response");
+    return -5;
+  }
+
+  inflater_init(*inflater, format, window, CONFIG_HTTP_INFLATE_WINDOW_SIZE, *body_cb, *user_data);
+  *body_cb = inflater_feed;
+  *user_data = *inflater;
+  return 0;
+}
+
+/** Checks the compressed stream ended with the body.
+ *
+ *  @param rc What receive_body() returned.
+ *  @param offset Number of compressed bytes received. On -10, set to the
+ *  decoded bytes already passed on, where the uncompressed range starts.
+ *  @return rc, or -5 if the stream is incomplete.
+ */
+static long inflate_finish(const Inflater *inflater, long rc, long *offset) {
+  if (inflater->err == INFLATE_ERR_WINDOW) {
+    LOG_WRN(
+        "Response needs a window larger than %d bytes, no longer requesting compression",
+        CONFIG_HTTP_INFLATE_WINDOW_SIZE
+    );
+    inflate_disabled = true;
+  }
+
+  if (rc == -10) {
+    /* The rest is requested without compression, from where the decoded
+     * output got to */
+    *offset = inflater->total_out;
+    return rc;
+  } else if (rc < 0) {
+    return rc;
+  } else if (!inflater_done(inflater)) {
+    LOG_ERR("Compressed body ended before the end of the stream");
+    return -5;
+  }
+
+  LOG_INF("Inflated %ld bytes to %u", *offset, inflater->total_out);
+  return rc;
+}
+#endif  // CONFIG_HTTP_INFLATE
+
+/** Receives the response. The body ends after Content-Length bytes, after the
+ *  last chunk of a chunked body or, without either, when the server closes the
+ *  connection. Framed bodies are complete as soon as their last byte arrives,
+ *  compressed ones are inflated on the way to body_cb.
+ *
+ *  @param range_start Where a range request starts, 0 for the whole body. On
+ *  -10, set to where the range requesting the rest must start.
+ *  @param deadline When the headers must have arrived by.
+ *  @param keep_alive Set if the whole response was read and the connection
+ *  can carry the next request.
+ */
+static long parse_response(
+    int *sock, char *recv_buf, int recv_buf_size, long *range_start, char *headers_buf,
+    int headers_buf_size, HttpHeaders *headers, http_body_cb_t body_cb, void *user_data,
+    HttpCache *cache, int64_t deadline, bool *keep_alive
+) {
+  long rc = 0;
+  long offset = *range_start;
+  long body_len;
+  const char *transfer_encoding;
+  BodyFraming framing = {.chunk = CHUNK_NONE, .remaining = -1};
+  const size_t mark = arena_mark();
+  uint32_t start = k_cycle_get_32();
+#ifdef CONFIG_HTTP_INFLATE
+  Inflater *inflater = NULL;
+#endif  // CONFIG_HTTP_INFLATE
+
+  *keep_alive = false;
+
+  int headers_size = parse_headers(sock, headers_buf, headers_buf_size, headers, cache, deadline);
+  http_stats_since(HTTP_STATS_FIRST_BYTE, start);
 
   if (headers_size == 0) {
     return -1;
+  } else if (headers_size == -7) {
+    /* A 304 never has a body */
+    *keep_alive = headers->persistent;
+    return headers_size;
   } else if (headers_size < 0) {
     return headers_size;
+  } else if ((offset > 0) && (headers->status != 206)) {
+    /* The server sent the whole body, or If-Range found it changed */
+    LOG_WRN("Range from %ld ignored, the body starts over", offset);
+    return -9;
   }
 
-#ifdef CONFIG_JES_FOTA
-  int rc = 0;
+  /* Chunked framing takes precedence over a Content-Length */
+  transfer_encoding = headers->values[HTTP_HEADER_TRANSFER_ENCODING];
+  if ((transfer_encoding != NULL) && (strstr(transfer_encoding, "chunked") != NULL)) {
+    framing.chunk = CHUNK_SIZE;
+    framing.remaining = 0;
+  } else if (headers->values[HTTP_HEADER_CONTENT_LENGTH] != NULL) {
+    framing.remaining = atol(headers->values[HTTP_HEADER_CONTENT_LENGTH]);
+  }
 
-  do {
-    if (write_nvs) {
-      bytes = recv(*sock, recv_body_buf, recv_body_buf_size, 0);
-      if (bytes < 0) {
-        if (errno == EMSGSIZE) {
-          LOG_WRN(
-              "recv() returned EMSGSIZE. Modem's secure socket buffer limit "
-              "reached.\nRetrying with new socket, Range: %ld-",
-              offset
-          );
-          return offset;
-        }
-        LOG_ERR("recv() body failed, %s", strerror(errno));
-        return bytes;
-      }
-      LOG_DBG("recv bytes: %d", bytes);
-      LOG_DBG("Total: %ld", offset);
-      rc = write_buffer_to_flash(recv_body_buf, bytes, false);
-      if (rc < 0) {
-        LOG_ERR("write_buffer_to_flash() failed, error: %s", strerror(errno));
-        return bytes;
-      }
+#ifdef CONFIG_HTTP_INFLATE
+  rc = inflate_setup(headers, &inflater, &body_cb, &user_data);
+  if (rc) {
+    goto clean_up;
+  }
+#endif  // CONFIG_HTTP_INFLATE
+
+  /* The start of the body may have arrived with the headers */
+  start = k_cycle_get_32();
+  if (headers->body_len > 0) {
+    body_len = body_received(&framing, headers->body, headers->body_len, body_cb, user_data);
+    if (body_len < 0) {
+      rc = body_len;
     } else {
-      bytes = recv(*sock, (recv_body_buf + offset), (recv_body_buf_size - offset), 0);
-      if (bytes < 0) {
-        LOG_ERR("recv() body failed, %s", strerror(errno));
-        return bytes;
-      }
-    }
-    offset += bytes;
-  } while (bytes != 0);
-#else
-  do {
-    bytes = recv(*sock, (recv_body_buf + offset), (recv_body_buf_size - offset), 0);
-    if (bytes < 0) {
-      LOG_ERR("recv() body failed, %s", strerror(errno));
-      return bytes;
+      offset += body_len;
     }
-    offset += bytes;
-  } while (bytes != 0);
-#endif  // CONFIG_JES_FOTA
+  }
+
+  if (rc == 0) {
+    rc = receive_body(sock, recv_buf, recv_buf_size, &framing, body_cb, user_data, &offset);
+  }
+  http_stats_since(HTTP_STATS_BODY, start);
+
+#ifdef CONFIG_HTTP_INFLATE
+  if (inflater != NULL) {
+    rc = inflate_finish(inflater, rc, &offset);
+  }
+#endif  // CONFIG_HTTP_INFLATE
+  if (rc == -10) {
+    *range_start = offset;
+  }
+  if (rc) {
+    goto clean_up;
+  }
 
   LOG_DBG("Received Body. Size: %ld bytes", offset);
   LOG_INF("Total bytes received: %ld", offset + headers_size);
 
-#ifdef CONFIG_JES_FOTA
-  if (write_nvs) {
-    rc = write_buffer_to_flash(recv_body_buf, 0, true);
+  *keep_alive = body_complete(&framing) && headers->persistent;
 
-    if (rc < 0) {
-      LOG_ERR("write_buffer_to_flash() failed, error: %s", strerror(errno));
-      return bytes;
-    }
-    return rc;
+clean_up:
+  arena_release(mark);
+  return rc;
+}
+
+static char *get_redirect_location(const HttpHeaders *headers) {
+  if (headers->values[HTTP_HEADER_LOCATION] == NULL) {
+    LOG_ERR("Location header missing");
   }
-#endif  // CONFIG_JES_FOTA
 
-  /* Make sure recv_buf is NULL terminated (for safe use with strstr) */
-  if (offset < recv_body_buf_size) {
-    *(recv_body_buf + offset) = '\0';
+  return headers->values[HTTP_HEADER_LOCATION];
+}
+
+/** The connection kept open for the next request to the same host */
+static struct {
+  int sock;
+  sec_tag_t sec_tag;
+  char hostname[255];
+} conn = {.sock = -1};
+
+static void http_close(void) {
+  if (conn.sock < 0) {
+    return;
+  }
+
+  LOG_DBG("Closing socket %d", conn.sock);
+  if (close(conn.sock)) {
+    LOG_ERR("close() failed, %s", strerror(errno));
+  }
+  conn.sock = -1;
+}
+
+/** Whether the kept connection can carry a request to hostname. A server that
+ *  closed it in the meantime shows up as a readable EOF. */
+static bool http_reusable(const char *hostname, sec_tag_t sec_tag) {
+  char c;
+
+  if ((conn.sock < 0) || (conn.sec_tag != sec_tag) || (strcmp(conn.hostname, hostname) != 0)) {
+    return false;
+  }
+
+  if ((recv(conn.sock, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0) &&
+      ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+    return true;
+  }
+
+  LOG_DBG("Socket %d closed by the server", conn.sock);
+  return false;
+}
+
+/** Opens a non-blocking socket for hostname and starts connecting it to
+ *  addr.
+ *
+ *  @return The socket, or -1 if it couldn't be opened or the connection
+ *  failed straight away.
+ */
+static int connect_start(const DnsAddr *addr, char *hostname, sec_tag_t sec_tag) {
+  int sock;
+  const sa_family_t family = addr->addr.ss_family;
+
+  if (sec_tag == NO_SEC_TAG) {
+    sock = socket(family, SOCK_STREAM, IPPROTO_TCP);
+  } else if (IS_ENABLED(CONFIG_MBEDTLS)) {
+    sock = socket(family, SOCK_STREAM | SOCK_NATIVE_TLS, IPPROTO_TLS_1_2);
   } else {
-    *(recv_body_buf + recv_body_buf_size - 1) = '\0';
+    sock = socket(family, SOCK_STREAM, IPPROTO_TLS_1_2);
   }
 
-  return EXIT_SUCCESS;
+  if (sock == -1) {
+    LOG_ERR("Failed to open socket!\n");
+    return -1;
+  }
+
+  if ((sec_tag != NO_SEC_TAG) && tls_setup(sock, hostname, sec_tag)) {
+    goto fail;
+  }
+
+  if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) == -1) {
+    LOG_ERR("Failed to make socket non-blocking, %s", strerror(errno));
+    goto fail;
+  }
+
+  LOG_DBG("Connecting socket %d to %s (%s)", sock, hostname, net_family2str(family));
+
+  if ((connect(sock, (struct sockaddr *)&addr->addr, addr->len) == -1) &&
+      (errno != EINPROGRESS)) {
+    LOG_WRN("connect() failed, %s", strerror(errno));
+    goto fail;
+  }
+
+  return sock;
+
+fail:
+  (void)close(sock);
+  return -1;
 }
 
-static char *get_redirect_location(char *headers_buf, int headers_buf_size) {
-  char *ptr;
+/** Resolves hostname, through the DNS cache, and opens conn to it.
+ *
+ *  Connections to the host's addresses are started
+ *  CONFIG_HTTP_CONNECT_ATTEMPT_DELAY_MS apart, or as soon as the previous one
+ *  fails, and the first to connect is kept. How long each took is reported
+ *  back to the cache to order the next attempt. The socket stays
+ *  non-blocking, every wait on it is bounded by poll().
+ *
+ *  @return 0 on success, EXIT_FAILURE if hostname couldn't be resolved, or -1
+ *  if no address could be connected to.
+ */
+static int http_connect(char *hostname, sec_tag_t sec_tag) {
+  int err;
+  int rc;
+  int sock = -1;
+  DnsAddrs addrs;
+  struct pollfd fds[CONFIG_DNS_CACHE_MAX_ADDRS];
+  int64_t started[CONFIG_DNS_CACHE_MAX_ADDRS];
+  size_t attempts = 0;
+  size_t pending = 0;
+  int64_t now = k_uptime_get();
+  int64_t next_attempt = now;
+  const int64_t deadline = now + CONFIG_HTTP_CONNECT_TIMEOUT_MS;
+  uint32_t start = k_cycle_get_32();
+
+  err = dns_cache_resolve(hostname, (sec_tag == NO_SEC_TAG) ? 80 : 443, &addrs);
+  http_stats_since(HTTP_STATS_DNS, start);
+  if (err) {
+    return EXIT_FAILURE;
+  }
 
-  ptr = strstr(headers_buf, "Location:");
-  if (ptr == NULL) {
-    ptr = strstr(headers_buf, "location:");
-    if (ptr == NULL) {
-      LOG_ERR("Location header missing");
-      return NULL;
+  start = k_cycle_get_32();
+
+  while ((sock == -1) && (now < deadline)) {
+    if ((attempts < addrs.count) && ((now >= next_attempt) || (pending == 0))) {
+      fds[attempts].fd = connect_start(&addrs.addrs[attempts], hostname, sec_tag);
+      fds[attempts].events = POLLOUT;
+      fds[attempts].revents = 0;
+      started[attempts] = now;
+      if (fds[attempts].fd == -1) {
+        dns_cache_report(hostname, &addrs.addrs[attempts], DNS_CONNECT_MS_FAILED);
+      } else {
+        pending++;
+      }
+      attempts++;
+      next_attempt = now + CONFIG_HTTP_CONNECT_ATTEMPT_DELAY_MS;
+      continue;
+    } else if (pending == 0) {
+      break;
+    }
+
+    rc = poll(
+        fds, attempts,
+        (int)(((attempts < addrs.count) ? MIN(next_attempt, deadline) : deadline) - now)
+    );
+    if (rc < 0) {
+      LOG_ERR("poll() failed, %s", strerror(errno));
+      break;
+    }
+    now = k_uptime_get();
+
+    for (size_t i = 0; (rc > 0) && (i < attempts); i++) {
+      int sock_err = 0;
+      socklen_t len = sizeof(sock_err);
+
+      if ((fds[i].fd == -1) || (fds[i].revents == 0)) {
+        continue;
+      }
+
+      (void)getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &sock_err, &len);
+      if ((sock_err == 0) && !(fds[i].revents & (POLLERR | POLLHUP))) {
+        LOG_INF(
+            "Connected to %s (%s) in %lld ms", hostname,
+            net_family2str(addrs.addrs[i].addr.ss_family), now - started[i]
+        );
+        dns_cache_report(hostname, &addrs.addrs[i], now - started[i]);
+        sock = fds[i].fd;
+        fds[i].fd = -1;
+        break;
+      }
+
+      LOG_WRN("connect() failed, %s", strerror(sock_err));
+      dns_cache_report(hostname, &addrs.addrs[i], DNS_CONNECT_MS_FAILED);
+      (void)close(fds[i].fd);
+      fds[i].fd = -1;
+      pending--;
+      /* Don't wait out the delay for the next address */
+      next_attempt = now;
     }
   }
 
-  ptr += 9;
+  /* Connections still in progress lost the race */
+  for (size_t i = 0; i < attempts; i++) {
+    if (fds[i].fd != -1) {
+      (void)close(fds[i].fd);
+    }
+  }
+  http_stats_since((sec_tag == NO_SEC_TAG) ? HTTP_STATS_CONNECT : HTTP_STATS_TLS, start);
 
-  while (*ptr == ' ') {
-    ptr++;
+  if (sock == -1) {
+    LOG_ERR("Failed to connect to any of the %zu addresses of %s", addrs.count, hostname);
+    /* The host may have moved, look it up again next time */
+    dns_cache_expire(hostname);
+    return -1;
   }
 
-  *strstr(ptr, "\r\n") = '\0';
+  conn.sock = sock;
+  conn.sec_tag = sec_tag;
+  (void)strncpy(conn.hostname, hostname, sizeof(conn.hostname) - 1);
+  conn.hostname[sizeof(conn.hostname) - 1] = '\0';
 
-  return ptr;
+  return 0;
 }
 
 static int send_http_request(
-    char *hostname, char *path, char *accept, sec_tag_t sec_tag, char *recv_body_buf,
-    int recv_body_buf_size, char *headers_buf, int headers_buf_size, _Bool write_nvs
+    char *hostname, char *path, char *accept, sec_tag_t sec_tag, char *recv_buf,
+    int recv_buf_size, http_body_cb_t body_cb, void *user_data, char *headers_buf,
+    int headers_buf_size, HttpHeaders *headers, HttpCache *cache, bool compressed, long range_start
 ) {
   int bytes;
   int err;
@@ -253,15 +963,45 @@ static int send_http_request(
   size_t offset;
   char *ptr;
   long rc = 0;
-  int sock = -1;
-  long range_start = 0;
+  long range_end;
+  int64_t start;
+  int64_t deadline;
+  uint32_t send_start;
+  bool reused;
+  bool keep_alive = false;
+  bool tls;
   // Keep track of retry attempts so we don't get in a loop
   int retry_client_error = 0;
+  /** Holds the hostname of a redirect, followed by its path */
+  char redirect_hostname_buf[255];
+  /** The URL requested, permanent redirects from it are cached */
+  const char *const origin_hostname = hostname;
+  const char *const origin_path = path;
+  bool permanent = true;
+  bool cached_redirect = false;
+
+  if ((cache != NULL) && (cache->expires > k_uptime_get())) {
+    LOG_INF("Last response fresh for %lld ms, skipping request", cache->expires - k_uptime_get());
+    return HTTP_CACHED;
+  }
 
-  struct addrinfo *addr_inf;
-  static struct addrinfo hints = {.ai_socktype = SOCK_STREAM, .ai_flags = AI_NUMERICSERV};
+  /* Go straight to where the URL permanently moved to */
+  if (redirect_cache_lookup(
+          hostname, path, redirect_hostname_buf, sizeof(redirect_hostname_buf), &tls
+      )) {
+    if (!tls) {
+      sec_tag = NO_SEC_TAG;
+    }
+    hostname = redirect_hostname_buf;
+    path = &redirect_hostname_buf[strlen(hostname) + 1];
+    cached_redirect = true;
+  }
 
 retry:
+  /* headers_buf is about to hold the request, nothing indexed in it stays
+   * valid */
+  (void)memset(headers, 0, sizeof(*headers));
+
   err = wdt_feed(wdt, wdt_channel_id);
   if (err) {
     LOG_ERR("Failed to feed watchdog. Err: %d", err);
@@ -281,195 +1021,240 @@ retry:
   // TODO: Change APP_VERSION_STRING to APP_VERSION_TWEAK_STRING when possible
   ptr = stpcpy(ptr, "User-Agent: EDB/" APP_VERSION_STRING " Stop-ID/" CONFIG_STOP_ID "\r\n");
   if (range_start > 0) {
-    ptr = stpcpy(ptr, "Range: ");
+    ptr = stpcpy(ptr, "Range: bytes=");
     ptr += sprintf(ptr, "%ld", range_start);
     ptr = stpcpy(ptr, "-\r\n");
+    /* Only continue the body if it is the one the range was taken from */
+    if ((cache != NULL) && ((cache->etag[0] != '\0') || (cache->last_modified[0] != '\0'))) {
+      ptr = stpcpy(ptr, "If-Range: ");
+      ptr = stpcpy(ptr, (cache->etag[0] != '\0') ? cache->etag : cache->last_modified);
+      ptr = stpcpy(ptr, "\r\n");
+    }
+  } else if (cache != NULL) {
+    /* A range request continues the body being received, it can't be
+     * conditional */
+    if (cache->etag[0] != '\0') {
+      ptr = stpcpy(ptr, "If-None-Match: ");
+      ptr = stpcpy(ptr, cache->etag);
+      ptr = stpcpy(ptr, "\r\n");
+    }
+    if (cache->last_modified[0] != '\0') {
+      ptr = stpcpy(ptr, "If-Modified-Since: ");
+      ptr = stpcpy(ptr, cache->last_modified);
+      ptr = stpcpy(ptr, "\r\n");
+    }
   }
+#ifdef CONFIG_HTTP_INFLATE
+  /* A range continues the encoding the body started with, the rest of a
+   * compressed body is requested uncompressed */
+  if (compressed && (range_start == 0) && !inflate_disabled) {
+    ptr = stpcpy(ptr, "Accept-Encoding: gzip, deflate\r\n");
+  }
+#endif  // CONFIG_HTTP_INFLATE
   ptr = stpcpy(ptr, "Accept: ");
   ptr = stpcpy(ptr, accept);
-  ptr = stpcpy(ptr, "\r\nConnection: close\r\n\r\n");
-
-  headers_size = (ptr - &headers_buf[0]);
-
-  LOG_DBG("Send Headers (size: %d):\n%s", headers_size, &headers_buf[0]);
-
-  if (sec_tag == NO_SEC_TAG) {
-    err = getaddrinfo(hostname, "80", &hints, &addr_inf);
+  if (IS_ENABLED(CONFIG_HTTP_KEEP_ALIVE)) {
+    ptr = stpcpy(ptr, "\r\nConnection: keep-alive\r\n\r\n");
   } else {
-    err = getaddrinfo(hostname, "443", &hints, &addr_inf);
-  }
-  if (err) {
-    LOG_ERR("getaddrinfo() failed, %s", strerror(errno));
-    return errno;
-  }
-
-  char peer_addr[INET6_ADDRSTRLEN];
-
-  if (inet_ntop(
-          addr_inf->ai_family, &((struct sockaddr_in *)(addr_inf->ai_addr))->sin_addr, peer_addr,
-          INET6_ADDRSTRLEN
-      ) == NULL) {
-    LOG_ERR("inet_ntop() failed, %s", strerror(errno));
-    return errno;
+    ptr = stpcpy(ptr, "\r\nConnection: close\r\n\r\n");
   }
 
-  LOG_DBG("Resolved %s (%s)", peer_addr, net_family2str(addr_inf->ai_family));
-
-  if (sec_tag == NO_SEC_TAG) {
-    sock = socket(addr_inf->ai_family, SOCK_STREAM, addr_inf->ai_protocol);
-  } else if (IS_ENABLED(CONFIG_MBEDTLS)) {
-    sock = socket(addr_inf->ai_family, SOCK_STREAM | SOCK_NATIVE_TLS, IPPROTO_TLS_1_2);
-  } else {
-    sock = socket(addr_inf->ai_family, SOCK_STREAM, IPPROTO_TLS_1_2);
-  }
+  headers_size = (ptr - &headers_buf[0]);
 
-  if (sock == -1) {
-    LOG_ERR("Failed to open socket!\n");
-    goto clean_up;
-  }
+  LOG_DBG("Send Headers (size: %d):\n%s", headers_size, &headers_buf[0]);
 
-  if (sec_tag != NO_SEC_TAG) {
-    err = tls_setup(sock, hostname, sec_tag);
-    if (err) {
+  start = k_uptime_get();
+  keep_alive = false;
+
+  reused = IS_ENABLED(CONFIG_HTTP_KEEP_ALIVE) && http_reusable(hostname, sec_tag);
+  if (!reused) {
+    http_close();
+    err = http_connect(hostname, sec_tag);
+    if (err > 0) {
+      return err;
+    } else if (err) {
+      rc = err;
       goto clean_up;
     }
   }
 
-  LOG_DBG(
-      "Connecting to %s:%d", hostname, ntohs(((struct sockaddr_in *)(addr_inf->ai_addr))->sin_port)
-  );
-
-  err = connect(sock, addr_inf->ai_addr, addr_inf->ai_addrlen);
-  if (err) {
-    LOG_ERR("connect() failed, %s", strerror(errno));
-    goto clean_up;
-  }
-
-  LOG_DBG(
-      "Socket %d addrinfo: ai_family=%d, ai_socktype=%d, ai_protocol=%d, "
-      "sa_family=%d, sin_port=%x",
-      sock, addr_inf->ai_family, addr_inf->ai_socktype, addr_inf->ai_protocol,
-      addr_inf->ai_addr->sa_family, ((struct sockaddr_in *)addr_inf->ai_addr)->sin_port
-  );
+  /* The request must be sent and the headers received by the first byte
+   * deadline */
+  deadline = k_uptime_get() + CONFIG_HTTP_FIRST_BYTE_TIMEOUT_MS;
 
   offset = 0;
+  send_start = k_cycle_get_32();
   do {
-    bytes = send(sock, &headers_buf[offset], headers_size - offset, 0);
-    if (bytes < 0) {
+    bytes = send(conn.sock, &headers_buf[offset], headers_size - offset, 0);
+    if ((bytes < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      rc = wait_socket(conn.sock, POLLOUT, deadline, "request to send");
+      if (rc) {
+        http_stats_since(HTTP_STATS_SEND, send_start);
+        goto clean_up;
+      }
+      continue;
+    } else if (bytes < 0) {
       LOG_ERR("send() failed, %s", strerror(errno));
+      if (reused) {
+        /* The server dropped the kept connection, start over on a new one */
+        http_close();
+        http_stats_retry();
+        goto retry;
+      }
+      rc = -1;
       goto clean_up;
     }
     offset += bytes;
   } while (offset < headers_size);
+  http_stats_since(HTTP_STATS_SEND, send_start);
 
-  LOG_INF("Sent %d bytes", offset);
+  LOG_INF("Sent %d bytes on socket %d (%s)", offset, conn.sock, reused ? "reused" : "new");
 
+  range_end = range_start;
   rc = parse_response(
-      &sock, recv_body_buf, recv_body_buf_size, range_start, headers_buf, headers_buf_size,
-      write_nvs
+      &conn.sock, recv_buf, recv_buf_size, &range_end, headers_buf, headers_buf_size, headers,
+      body_cb, user_data, cache, deadline, &keep_alive
   );
-  if (rc == -1) {
+  if (reused && ((rc == -1) || ((rc == -8) && (headers->status == 0)))) {
+    /* A mobile network can drop an idle connection without telling either
+     * end, so a kept connection that stays silent is retried too */
+    LOG_WRN("Kept connection closed before the response, reconnecting");
+    http_close();
+    http_stats_retry();
+    goto retry;
+  } else if (rc == -1) {
     LOG_ERR("EOF or error in response headers.");
   }
 
+  LOG_INF(
+      "Request took %lld ms on a %s connection", k_uptime_get() - start, reused ? "reused" : "new"
+  );
+
 clean_up:
-  LOG_DBG("Closing socket %d", sock);
-  err = close(sock);
-  if (err) {
-    LOG_ERR("close() failed, %s", strerror(errno));
+  if (!keep_alive || !IS_ENABLED(CONFIG_HTTP_KEEP_ALIVE)) {
+    http_close();
   }
 
-  (void)freeaddrinfo(addr_inf);
-
-  LOG_DBG("Response Headers:\n%s", &headers_buf[0]);
-
   if (rc == -2) {
     // Redirect returned; follow redirect
     goto redirect;
-  } else if (rc > 1) {
-    // Partial transefer complete; reconnect with new range request
-    range_start = rc;
+  } else if (rc == -7) {
+    LOG_INF("Not modified since the last response");
+    return HTTP_CACHED;
+  } else if (rc == -9) {
+    return HTTP_RANGE_IGNORED;
+  } else if ((rc == -10) && (range_end > range_start)) {
+    // Partial transfer complete; reconnect with new range request
+    range_start = range_end;
+    http_stats_retry();
     goto retry;
+  } else if (rc == -10) {
+    LOG_ERR("Socket buffer limit reached before any of the body was received");
+    return EXIT_FAILURE;
   } else if ((rc == -3) && (retry_client_error == 0)) {
     // The BusTracker endpoint occasionally returns 404; retry once
     LOG_WRN("GET request failed once, retrying...");
     retry_client_error = 1;
+    http_stats_retry();
     goto retry;
+  } else if (rc < 0) {
+    LOG_ERR("GET request failed. Err: %ld", rc);
+    if (cached_redirect && ((rc == -3) || (rc == -4))) {
+      /* The resource may have moved again, or back */
+      redirect_cache_forget(origin_hostname, origin_path);
+    }
+    return EXIT_FAILURE;
   }
 
   return EXIT_SUCCESS;
 
 redirect:
-  ptr = get_redirect_location(headers_buf, headers_buf_size);
-  char redirect_hostname_buf[255];
+  ptr = get_redirect_location(headers);
   LOG_INF("Redirect location: %s", ptr);
+  http_stats_redirect();
 
   if (ptr == NULL) {
     LOG_ERR("get_redirect_location returned NULL pointer");
     return EXIT_FAILURE;
-  } else {
-    /* Assume the host is the same */
-    if (*ptr == '/') {
-      path = strcpy(redirect_hostname_buf, ptr);
-      LOG_DBG("path ptr: %s", path);
-      /* Assume we're dealing with a url */
-    } else if (*ptr == 'h') {
-      if (strncmp(ptr, "https", 5) == 0) {
-        if (sec_tag == NO_SEC_TAG) {
-          LOG_ERR(
-              "Redirect requires TLS, but no TLS sec_tag was assigned. Assign "
-              "correct sec_tag in the code "
-              "Aborting."
-          );
-          return EXIT_FAILURE;
-        }
-        ptr += 8;
-      } else {
-        ptr += 7;
-        sec_tag = NO_SEC_TAG;
-      }
-      hostname = ptr;
-      ptr = strstr(ptr, "/");
-
-      if (ptr == NULL) {
-        LOG_ERR("strstr returned NULL pointer");
-        return EXIT_FAILURE;
-      } else {
-        *ptr++ = '\0';
+  }
 
-        path = stpcpy(redirect_hostname_buf, hostname);
-        *++path = '/';
+  tls = (sec_tag != NO_SEC_TAG);
+  hostname = http_location_resolve(
+      ptr, hostname, redirect_hostname_buf, sizeof(redirect_hostname_buf), &path, &tls
+  );
+  if (hostname == NULL) {
+    return EXIT_FAILURE;
+  }
+  LOG_DBG("path ptr: %s", path);
+
+  if (!tls) {
+    sec_tag = NO_SEC_TAG;
+  } else if (sec_tag == NO_SEC_TAG) {
+    LOG_ERR(
+        "Redirect requires TLS, but no TLS sec_tag was assigned. Assign "
+        "correct sec_tag in the code "
+        "Aborting."
+    );
+    return EXIT_FAILURE;
+  }
 
-        (void)strcpy((path + 1), ptr);
-        hostname = redirect_hostname_buf;
-      }
-    } else {
-      LOG_ERR("Bad redirect location");
-      return EXIT_FAILURE;
-    }
+  /* Only a chain of permanent redirects says where the URL itself moved */
+  permanent = permanent && ((headers->status == 301) || (headers->status == 308));
+  if (permanent) {
+    redirect_cache_store(origin_hostname, origin_path, hostname, path, sec_tag != NO_SEC_TAG);
   }
 
   goto retry;
 }
 
 int http_request_stop_json(
-    char *stop_body_buf, int stop_body_buf_size, char *headers_buf, int headers_buf_size
+    char *recv_buf, int recv_buf_size, http_body_cb_t body_cb, void *user_data,
+    char *headers_buf, int headers_buf_size, HttpCache *cache
 ) {
   int err;
+  HttpHeaders headers;
+
+#ifdef CONFIG_STOP_REQUEST_JES
+  /** Make the size 255 incase we get a redirect with a longer hostname */
+  static char hostname[255] = CONFIG_STOP_REQUEST_JES_HOSTNAME;
 
+  /** Make the size 255 incase we get a redirect with a longer path */
+  static char path[255] = CONFIG_STOP_REQUEST_JES_PATH;
+
+  const sec_tag_t sec_tag = JES_SEC_TAG;
+#ifdef CONFIG_STOP_REQUEST_JES_CBOR
+  char *accept = "application/cbor";
+#else
+  char *accept = "application/json";
+#endif  // CONFIG_STOP_REQUEST_JES_CBOR
+#elif defined(CONFIG_STOP_REQUEST_GTFS_RT)
+  /** Make the size 255 incase we get a redirect with a longer hostname */
+  static char hostname[255] = CONFIG_STOP_REQUEST_GTFS_RT_HOSTNAME;
+
+  /** Make the size 255 incase we get a redirect with a longer path */
+  static char path[255] = CONFIG_STOP_REQUEST_GTFS_RT_PATH;
+
+  const sec_tag_t sec_tag = NO_SEC_TAG;
+  char *accept = "application/x-protobuf";
+#else
   /** Make the size 255 incase we get a redirect with a longer hostname */
   static char hostname[255] = CONFIG_STOP_REQUEST_BUSTRACKER_HOSTNAME;
 
   /** Make the size 255 incase we get a redirect with a longer path */
   static char path[255] = CONFIG_STOP_REQUEST_BUSTRACKER_PATH;
 
+  const sec_tag_t sec_tag =
+      IS_ENABLED(CONFIG_STOP_REQUEST_BUSTRACKER_USE_TLS) ? BUSTRACKER_SEC_TAG : NO_SEC_TAG;
+  char *accept = "application/json";
+#endif
+
   if (k_sem_take(&lte_connected_sem, K_SECONDS(30)) != 0) {
     LOG_ERR("Failed to take lte_connected_sem");
     err = 1;
   } else {
     err = send_http_request(
-        hostname, path, "application/json", NO_SEC_TAG, stop_body_buf, stop_body_buf_size,
-        headers_buf, headers_buf_size, false
+        hostname, path, accept, sec_tag, recv_buf, recv_buf_size, body_cb, user_data, headers_buf,
+        headers_buf_size, &headers, cache, true, 0
     );
     k_sem_give(&lte_connected_sem);
   }
@@ -478,8 +1263,18 @@ int http_request_stop_json(
 }
 
 #if CONFIG_JES_FOTA
+static int firmware_body_cb(const char *data, size_t len, void *user_data) {
+  int rc = write_buffer_to_flash(data, len, false);
+  if (rc < 0) {
+    LOG_ERR("write_buffer_to_flash() failed, error: %s", strerror(errno));
+    return rc;
+  }
+  return 0;
+}
+
 int http_get_firmware(
-    char *write_buf, int write_buf_size, char *headers_buf, int headers_buf_size
+    char *path, bool compressed, char *write_buf, int write_buf_size, char *headers_buf,
+    int headers_buf_size, HttpHeaders *headers, HttpCache *cache, long offset
 ) {
   int err;
 
@@ -488,8 +1283,9 @@ int http_get_firmware(
     err = 1;
   } else {
     err = send_http_request(
-        CONFIG_JES_FOTA_HOSTNAME, CONFIG_JES_FOTA_PATH, "application/octet-stream", JES_SEC_TAG,
-        write_buf, write_buf_size, headers_buf, headers_buf_size, true
+        CONFIG_JES_FOTA_HOSTNAME, path, "application/octet-stream", JES_SEC_TAG, write_buf,
+        write_buf_size, firmware_body_cb, NULL, headers_buf, headers_buf_size, headers, cache,
+        compressed, offset
     );
 
     k_sem_give(&lte_connected_sem);
@@ -498,3 +1294,22 @@ int http_get_firmware(
   return err;
 }
 #endif  // CONFIG_JES_FOTA
+
+K_THREAD_STACK_DEFINE(http_work_q_stack, CONFIG_HTTP_WORK_QUEUE_STACK_SIZE);
+static struct k_work_q http_work_q;
+
+static int http_work_q_init(void) {
+  const struct k_work_queue_config config = {.name = "http_work_q"};
+
+  k_work_queue_start(
+      &http_work_q, http_work_q_stack, K_THREAD_STACK_SIZEOF(http_work_q_stack),
+      CONFIG_HTTP_WORK_QUEUE_PRIORITY, &config
+  );
+  return 0;
+}
+
+SYS_INIT(http_work_q_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+int http_submit(struct k_work *work) {
+  return k_work_submit_to_queue(&http_work_q, work);
+}
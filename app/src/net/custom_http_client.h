@@ -5,29 +5,126 @@
 #ifndef CUSTOM_HTTP_CLIENT_H
 #define CUSTOM_HTTP_CLIENT_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
 enum response_code {
   HTTP_NULL,
   HTTP_INFO,
   HTTP_SUCCESS,
   HTTP_REDIRECT,
   HTTP_CLIENT_ERROR,
-  HTTP_SERVER_ERROR
+  HTTP_SERVER_ERROR,
+  HTTP_NOT_MODIFIED
+};
+
+/** Response headers indexed by HttpHeaders */
+enum http_header {
+  HTTP_HEADER_CONTENT_LENGTH,
+  HTTP_HEADER_TRANSFER_ENCODING,
+  HTTP_HEADER_CONTENT_ENCODING,
+  HTTP_HEADER_CONNECTION,
+  HTTP_HEADER_LOCATION,
+  HTTP_HEADER_ETAG,
+  HTTP_HEADER_LAST_MODIFIED,
+  HTTP_HEADER_CACHE_CONTROL,
+  HTTP_HEADER_AGE,
+  HTTP_HEADER_DATE,
+  HTTP_HEADER_SHA256,
+  HTTP_HEADER_COUNT
 };
 
-/** @brief Makes an HTTP GET request and returns a char pointer to the HTTP
- * response body buffer.
+/** Index of a response, built while its headers are received so they are
+ *  never searched again. The values point into the headers buffer and are
+ *  only valid until the next request reuses it. */
+typedef struct HttpHeaders {
+  /** Status code, 0 if the status line is missing */
+  int status;
+  /** Whether the server keeps the connection open after this response */
+  bool persistent;
+  /** Value of each enum http_header, NULL if the header is missing */
+  char *values[HTTP_HEADER_COUNT];
+  /** Start of the body, received in the same recv() as the end of the
+   *  headers */
+  char *body;
+  size_t body_len;
+} HttpHeaders;
+
+/** Returned by http_request_stop_json() when the last response is still
+ *  fresh, or the server answered 304 Not Modified. body_cb isn't called. */
+#define HTTP_CACHED 304
+
+/** Returned when a range request was answered with the whole body instead of
+ *  206 Partial Content, as when If-Range finds it changed. Nothing of the
+ *  response was passed to body_cb. */
+#define HTTP_RANGE_IGNORED 200
+
+/** Longest ETag and Last-Modified values kept, including the terminator */
+#define HTTP_ETAG_SIZE 64
+#define HTTP_LAST_MODIFIED_SIZE 32
+
+/** Validators and freshness of the last response for a resource, used to make
+ *  the next request for it conditional. */
+typedef struct HttpCache {
+  char etag[HTTP_ETAG_SIZE];
+  char last_modified[HTTP_LAST_MODIFIED_SIZE];
+  /** k_uptime_get() until which the response is fresh, 0 if it must be
+   *  revalidated */
+  int64_t expires;
+} HttpCache;
+
+/** @brief Forgets the last response, so the next request is unconditional. */
+void http_cache_clear(HttpCache *cache);
+
+/** @brief Called with each chunk of the response body as it is received.
+ *
+ * @return 0 to keep receiving, anything else aborts the transfer.
+ */
+typedef int (*http_body_cb_t)(const char *data, size_t len, void *user_data);
+
+/** @brief Runs work on the HTTP work queue, so requests made from it don't
+ * block the caller. Completion can be reported with a k_poll_signal.
+ *
+ * @return What k_work_submit_to_queue() returned.
+ */
+int http_submit(struct k_work *work);
+
+/** @brief Makes an HTTP GET request for the stop JSON and passes the
+ * response body to body_cb as it is received.
+ *
+ * @param recv_buf Buffer each recv() chunk is read into.
+ * @param cache Validators of the last stop response, updated from the response
+ * headers.
+ *
+ * @return 0 on success, HTTP_CACHED if the last response is still current,
+ * or non-zero if the request failed or timed out.
  */
 int http_request_stop_json(
-    char *stop_body_buf, int stop_body_buf_size, char *headers_buf,
-    int headers_buf_size
+    char *recv_buf, int recv_buf_size, http_body_cb_t body_cb, void *user_data,
+    char *headers_buf, int headers_buf_size, HttpCache *cache
 );
 
 #ifdef CONFIG_JES_FOTA
 /** @brief Makes an HTTP GET request to download a firmware update file and
  * writes it to flash.
+ *
+ * @param path Path of the firmware file on CONFIG_JES_FOTA_HOSTNAME.
+ * @param compressed Whether to accept the file gzip-compressed.
+ * @param headers Index of the response headers, the values point into
+ * headers_buf.
+ * @param cache Validators of the firmware file, updated from the response
+ * headers. A download resumed from offset only continues if they still match.
+ * @param offset Number of bytes of the file already written, 0 to download
+ * all of it.
+ *
+ * @return 0 on success, HTTP_RANGE_IGNORED if the file changed since offset
+ * bytes of it were written, or non-zero if the request failed.
  */
 int http_get_firmware(
-    char *write_buf, int write_buf_size, char *headers_buf, int headers_buf_size
+    char *path, bool compressed, char *write_buf, int write_buf_size, char *headers_buf,
+    int headers_buf_size, HttpHeaders *headers, HttpCache *cache, long offset
 );
 #endif  // CONFIG_JES_FOTA
 
@@ -0,0 +1,180 @@
+#ifdef CONFIG_JES_FOTA_DELTA
+
+/** @headerfile delta_patch.h */
+#include "net/delta_patch.h"
+
+#include <string.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_REGISTER(delta_patch);
+
+void delta_patch_init(DeltaPatch *patch, const struct flash_area *source, delta_patch_out_t out) {
+  (void)memset(patch, 0, sizeof(*patch));
+  patch->state = DELTA_PATCH_HEADER;
+  patch->source = source;
+  patch->out = out;
+}
+
+bool delta_patch_done(const DeltaPatch *patch) {
+  return patch->state == DELTA_PATCH_DONE;
+}
+
+/** Checks the running image is the one the patch was made from. */
+static int check_source(DeltaPatch *patch, uint32_t crc) {
+  uint32_t source_crc = 0;
+  int rc;
+
+  if (patch->source_size > flash_area_get_size(patch->source)) {
+    LOG_ERR("Patch is from a %zu byte image, larger than the slot", patch->source_size);
+    return DELTA_PATCH_ERR_SOURCE;
+  }
+
+  for (size_t offset = 0; offset < patch->source_size; offset += sizeof(patch->buf)) {
+    const size_t len = MIN(sizeof(patch->buf), patch->source_size - offset);
+
+    rc = flash_area_read(patch->source, offset, patch->buf, len);
+    if (rc) {
+      return rc;
+    }
+    source_crc = crc32_ieee_update(source_crc, patch->buf, len);
+  }
+
+  if (source_crc != crc) {
+    LOG_ERR("Patch isn't for the running image");
+    return DELTA_PATCH_ERR_SOURCE;
+  }
+  return 0;
+}
+
+/** Takes the header or a record once all of it has arrived. */
+static int parse_field(DeltaPatch *patch) {
+  const uint8_t *field = patch->field;
+  int rc;
+
+  patch->field_len = 0;
+
+  if (patch->state == DELTA_PATCH_HEADER) {
+    if (sys_get_le32(field) != DELTA_PATCH_MAGIC) {
+      return DELTA_PATCH_ERR_DATA;
+    }
+    patch->source_size = sys_get_le32(&field[4]);
+    patch->target_size = sys_get_le32(&field[12]);
+    LOG_INF(
+        "Patching a %zu byte image into a %zu byte one", patch->source_size, patch->target_size
+    );
+
+    rc = check_source(patch, sys_get_le32(&field[8]));
+    if (rc) {
+      return rc;
+    }
+    patch->state = DELTA_PATCH_RECORD;
+    return 0;
+  }
+
+  const size_t left = patch->target_size - patch->target_pos;
+  const size_t add_len = sys_get_le32(field);
+
+  patch->insert_len = sys_get_le32(&field[4]);
+  patch->seek = (int32_t)sys_get_le32(&field[8]);
+
+  /* A record can't make more than what is left of the new image, nor add to
+   * bytes outside the running one */
+  if ((add_len > left) || (patch->insert_len > (left - add_len)) ||
+      ((add_len > 0) &&
+       ((patch->source_pos < 0) || ((patch->source_pos + add_len) > patch->source_size)))) {
+    LOG_ERR("Patch record out of bounds");
+    return DELTA_PATCH_ERR_DATA;
+  }
+
+  patch->remaining = add_len;
+  patch->state = DELTA_PATCH_ADD;
+  return 0;
+}
+
+/** Adds len patch bytes to the running image and passes the sum on. */
+static int add(DeltaPatch *patch, const uint8_t *data, size_t len) {
+  int rc = flash_area_read(patch->source, patch->source_pos, patch->buf, len);
+
+  if (rc) {
+    return rc;
+  }
+  for (size_t i = 0; i < len; i++) {
+    patch->buf[i] += data[i];
+  }
+  patch->source_pos += len;
+  return patch->out((const char *)patch->buf, len);
+}
+
+/** Moves on from an add or insert that is complete, possibly to the end. */
+static bool next_state(DeltaPatch *patch) {
+  if (patch->remaining > 0) {
+    return false;
+  } else if (patch->state == DELTA_PATCH_ADD) {
+    patch->remaining = patch->insert_len;
+    patch->state = DELTA_PATCH_INSERT;
+    return true;
+  } else if (patch->state == DELTA_PATCH_INSERT) {
+    patch->source_pos += patch->seek;
+    patch->state =
+        (patch->target_pos == patch->target_size) ? DELTA_PATCH_DONE : DELTA_PATCH_RECORD;
+    return true;
+  }
+  return false;
+}
+
+int delta_patch_write(DeltaPatch *patch, const char *data, size_t len) {
+  size_t n;
+  size_t size;
+  int rc = 0;
+
+  while (rc == 0) {
+    if (next_state(patch)) {
+      continue;
+    } else if (len == 0) {
+      break;
+    }
+
+    switch (patch->state) {
+      case DELTA_PATCH_HEADER:
+      case DELTA_PATCH_RECORD:
+        size = (patch->state == DELTA_PATCH_HEADER) ? DELTA_PATCH_HEADER_SIZE
+                                                    : DELTA_PATCH_RECORD_SIZE;
+        n = MIN(len, size - patch->field_len);
+        (void)memcpy(&patch->field[patch->field_len], data, n);
+        patch->field_len += n;
+        if (patch->field_len == size) {
+          rc = parse_field(patch);
+        }
+        break;
+
+      case DELTA_PATCH_ADD:
+        n = MIN(len, MIN(patch->remaining, sizeof(patch->buf)));
+        rc = add(patch, (const uint8_t *)data, n);
+        patch->remaining -= n;
+        patch->target_pos += n;
+        break;
+
+      case DELTA_PATCH_INSERT:
+        n = MIN(len, patch->remaining);
+        rc = patch->out(data, n);
+        patch->remaining -= n;
+        patch->target_pos += n;
+        break;
+
+      case DELTA_PATCH_DONE:
+      default:
+        LOG_ERR("%zu bytes after the end of the patch", len);
+        return DELTA_PATCH_ERR_DATA;
+    }
+
+    data += n;
+    len -= n;
+  }
+
+  return rc;
+}
+
+#endif  // CONFIG_JES_FOTA_DELTA
@@ -0,0 +1,89 @@
+/** @file delta_patch.h
+ *  @brief Streaming patches from the running image to a new one.
+ *
+ *  A patch is made by scripts/make_delta.py from the signed image the board
+ *  runs and the one it should run. It is applied as it is received, reading
+ *  the running image from flash, so neither image is ever held in RAM.
+ *
+ *  The patch is little-endian. A 16 byte header holds DELTA_PATCH_MAGIC, the
+ *  size and CRC-32 of the image it was made from, and the size of the image it
+ *  makes. Records follow until the whole new image is made, each one:
+ *
+ *  - u32 add_len, u32 insert_len, i32 seek
+ *  - add_len bytes, each added to the next byte of the running image
+ *  - insert_len bytes of the new image, copied as is
+ *
+ *  after which the position in the running image moves by seek. Code that only
+ *  moved makes runs of small differences, which the HTTP compression of the
+ *  patch shrinks to almost nothing.
+ */
+
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/storage/flash_map.h>
+
+/** "EDBD", the start of every patch */
+#define DELTA_PATCH_MAGIC 0x44424445U
+
+#define DELTA_PATCH_HEADER_SIZE 16
+#define DELTA_PATCH_RECORD_SIZE 12
+
+/** The patch isn't for the running image */
+#define DELTA_PATCH_ERR_SOURCE -1
+/** The patch is malformed */
+#define DELTA_PATCH_ERR_DATA -2
+
+/** @brief Called with each part of the new image as it is made.
+ *
+ *  @return 0 to go on, anything else aborts the patch.
+ */
+typedef int (*delta_patch_out_t)(const char *data, size_t len);
+
+enum delta_patch_state {
+  DELTA_PATCH_HEADER,
+  DELTA_PATCH_RECORD,
+  DELTA_PATCH_ADD,
+  DELTA_PATCH_INSERT,
+  DELTA_PATCH_DONE,
+};
+
+typedef struct DeltaPatch {
+  enum delta_patch_state state;
+  /** The running image */
+  const struct flash_area *source;
+  size_t source_size;
+  /** Where the next added bytes are read from the running image */
+  long source_pos;
+  size_t target_size;
+  /** Bytes of the new image made so far */
+  size_t target_pos;
+  /** Bytes left of the current add or insert */
+  size_t remaining;
+  size_t insert_len;
+  long seek;
+  delta_patch_out_t out;
+  /** The header or record being received */
+  uint8_t field[DELTA_PATCH_HEADER_SIZE];
+  size_t field_len;
+  /** Running image bytes the add bytes are added to */
+  uint8_t buf[256];
+} DeltaPatch;
+
+/** @brief Starts applying a patch against source. */
+void delta_patch_init(DeltaPatch *patch, const struct flash_area *source, delta_patch_out_t out);
+
+/** @brief Applies the next len bytes of the patch.
+ *
+ *  @return 0, DELTA_PATCH_ERR_SOURCE or DELTA_PATCH_ERR_DATA, or what out or
+ *  reading the running image returned.
+ */
+int delta_patch_write(DeltaPatch *patch, const char *data, size_t len);
+
+/** @brief Whether the whole new image was made. */
+bool delta_patch_done(const DeltaPatch *patch);
+
+#endif  // DELTA_PATCH_H
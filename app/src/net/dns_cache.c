@@ -0,0 +1,252 @@
+/** @headerfile dns_cache.h */
+#include "net/dns_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(dns_cache);
+
+/** Longer hostnames are looked up every time */
+#define DNS_CACHE_HOSTNAME_SIZE 64
+
+typedef struct DnsEntry {
+  char hostname[DNS_CACHE_HOSTNAME_SIZE];
+  /** Uptime the addresses expire at, 0 to look the host up again */
+  int64_t expires;
+  /** Uptime the entry was last used, the least recently used one is
+   *  replaced */
+  int64_t used;
+  DnsAddrs addrs;
+} DnsEntry;
+
+static DnsEntry entries[CONFIG_DNS_CACHE_SIZE];
+
+K_MUTEX_DEFINE(dns_cache_mutex);
+
+static DnsEntry *find_entry(const char *hostname) {
+  for (size_t i = 0; i < CONFIG_DNS_CACHE_SIZE; i++) {
+    if (strcmp(entries[i].hostname, hostname) == 0) {
+      return &entries[i];
+    }
+  }
+  return NULL;
+}
+
+/** Takes a free entry, or the least recently used one, for hostname. */
+static DnsEntry *new_entry(const char *hostname) {
+  DnsEntry *entry = &entries[0];
+
+  if (strlen(hostname) >= sizeof(entry->hostname)) {
+    LOG_WRN("Hostname %s too long to cache", hostname);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < CONFIG_DNS_CACHE_SIZE; i++) {
+    if (entries[i].hostname[0] == '\0') {
+      entry = &entries[i];
+      break;
+    } else if (entries[i].used < entry->used) {
+      entry = &entries[i];
+    }
+  }
+
+  (void)strcpy(entry->hostname, hostname);
+  return entry;
+}
+
+static void log_addr(const char *hostname, const struct sockaddr *addr) {
+  char peer_addr[INET6_ADDRSTRLEN];
+  const void *src = (addr->sa_family == AF_INET6)
+                        ? (const void *)&((const struct sockaddr_in6 *)addr)->sin6_addr
+                        : (const void *)&((const struct sockaddr_in *)addr)->sin_addr;
+
+  if (inet_ntop(addr->sa_family, src, peer_addr, sizeof(peer_addr)) != NULL) {
+    LOG_DBG("Resolved %s to %s (%s)", hostname, peer_addr, net_family2str(addr->sa_family));
+  }
+}
+
+static bool copy_addr(DnsAddr *dest, const struct addrinfo *ai) {
+  if (ai->ai_addrlen > sizeof(dest->addr)) {
+    return false;
+  }
+  (void)memcpy(&dest->addr, ai->ai_addr, ai->ai_addrlen);
+  dest->len = ai->ai_addrlen;
+  dest->connect_ms = DNS_CONNECT_MS_UNKNOWN;
+  return true;
+}
+
+static int lookup(const char *hostname, DnsAddrs *addrs) {
+  int err;
+  struct addrinfo *addr_inf;
+  static struct addrinfo hints = {.ai_socktype = SOCK_STREAM};
+
+  err = getaddrinfo(hostname, NULL, &hints, &addr_inf);
+  if (err) {
+    LOG_ERR("getaddrinfo() %s failed, %d", hostname, err);
+    return err;
+  }
+
+  /* Alternate between the first family returned and the other one, so a
+   * broken IPv6 or IPv4 path only costs one attempt */
+  const struct addrinfo *next[2] = {addr_inf, addr_inf};
+  const sa_family_t first = addr_inf->ai_family;
+
+  addrs->count = 0;
+  for (size_t turn = 0; addrs->count < ARRAY_SIZE(addrs->addrs); turn++) {
+    const struct addrinfo **ai = &next[turn & 1];
+
+    while ((*ai != NULL) && (((*ai)->ai_family == first) != ((turn & 1) == 0))) {
+      *ai = (*ai)->ai_next;
+    }
+    if (*ai == NULL) {
+      if (next[(turn + 1) & 1] == NULL) {
+        break;
+      }
+      continue;
+    }
+
+    if (copy_addr(&addrs->addrs[addrs->count], *ai)) {
+      log_addr(hostname, (*ai)->ai_addr);
+      addrs->count++;
+    }
+    *ai = (*ai)->ai_next;
+  }
+  (void)freeaddrinfo(addr_inf);
+
+  if (addrs->count == 0) {
+    LOG_ERR("getaddrinfo() %s returned no usable addresses", hostname);
+    return EXIT_FAILURE;
+  }
+  return 0;
+}
+
+/** Whether a and b are the same host address, whatever their ports. */
+static bool addr_equal(const DnsAddr *a, const DnsAddr *b) {
+  if (a->addr.ss_family != b->addr.ss_family) {
+    return false;
+  } else if (a->addr.ss_family == AF_INET6) {
+    return memcmp(
+               &((const struct sockaddr_in6 *)&a->addr)->sin6_addr,
+               &((const struct sockaddr_in6 *)&b->addr)->sin6_addr, sizeof(struct in6_addr)
+           ) == 0;
+  }
+  return ((const struct sockaddr_in *)&a->addr)->sin_addr.s_addr ==
+         ((const struct sockaddr_in *)&b->addr)->sin_addr.s_addr;
+}
+
+/** Stable sort by connect_ms, there are only a few addresses. */
+static void sort_addrs(DnsAddrs *addrs) {
+  for (size_t i = 1; i < addrs->count; i++) {
+    const DnsAddr addr = addrs->addrs[i];
+    size_t j = i;
+
+    for (; (j > 0) && (addrs->addrs[j - 1].connect_ms > addr.connect_ms); j--) {
+      addrs->addrs[j] = addrs->addrs[j - 1];
+    }
+    addrs->addrs[j] = addr;
+  }
+}
+
+/** Keeps what is known about addresses a new lookup returned again. */
+static void carry_over(DnsAddrs *addrs, const DnsAddrs *old) {
+  for (size_t i = 0; i < addrs->count; i++) {
+    for (size_t j = 0; j < old->count; j++) {
+      if (addr_equal(&addrs->addrs[i], &old->addrs[j])) {
+        addrs->addrs[i].connect_ms = old->addrs[j].connect_ms;
+        break;
+      }
+    }
+  }
+  sort_addrs(addrs);
+}
+
+static void set_port(DnsAddr *addr, uint16_t port) {
+  if (addr->addr.ss_family == AF_INET6) {
+    ((struct sockaddr_in6 *)&addr->addr)->sin6_port = htons(port);
+  } else {
+    ((struct sockaddr_in *)&addr->addr)->sin_port = htons(port);
+  }
+}
+
+int dns_cache_resolve(const char *hostname, uint16_t port, DnsAddrs *addrs) {
+  int err = 0;
+  const int64_t now = k_uptime_get();
+
+  (void)k_mutex_lock(&dns_cache_mutex, K_FOREVER);
+
+  DnsEntry *entry = find_entry(hostname);
+
+  if ((entry != NULL) && (entry->expires > now)) {
+    LOG_DBG("%s resolved from the cache", hostname);
+  } else {
+    err = lookup(hostname, addrs);
+    if (err == 0) {
+      if (entry == NULL) {
+        entry = new_entry(hostname);
+      } else {
+        carry_over(addrs, &entry->addrs);
+      }
+      if (entry != NULL) {
+        entry->addrs = *addrs;
+        entry->expires = now + ((int64_t)CONFIG_DNS_CACHE_TTL_SECONDS * MSEC_PER_SEC);
+      }
+    } else if (entry != NULL) {
+      /* Stays expired, so the next request tries DNS again */
+      LOG_WRN("Using the last known addresses of %s", hostname);
+      err = 0;
+    }
+  }
+
+  if ((entry != NULL) && (err == 0)) {
+    *addrs = entry->addrs;
+    entry->used = now;
+  }
+
+  (void)k_mutex_unlock(&dns_cache_mutex);
+
+  if (err == 0) {
+    for (size_t i = 0; i < addrs->count; i++) {
+      set_port(&addrs->addrs[i], port);
+    }
+  }
+
+  return err;
+}
+
+void dns_cache_report(const char *hostname, const DnsAddr *addr, int32_t connect_ms) {
+  (void)k_mutex_lock(&dns_cache_mutex, K_FOREVER);
+
+  DnsEntry *entry = find_entry(hostname);
+
+  for (size_t i = 0; (entry != NULL) && (i < entry->addrs.count); i++) {
+    DnsAddr *known = &entry->addrs.addrs[i];
+
+    if (!addr_equal(known, addr)) {
+      continue;
+    }
+    if ((connect_ms == DNS_CONNECT_MS_FAILED) || (known->connect_ms >= DNS_CONNECT_MS_UNKNOWN)) {
+      known->connect_ms = connect_ms;
+    } else {
+      /* Smooth out the odd slow connection */
+      known->connect_ms = ((known->connect_ms * 3) + connect_ms) / 4;
+    }
+    sort_addrs(&entry->addrs);
+    break;
+  }
+
+  (void)k_mutex_unlock(&dns_cache_mutex);
+}
+
+void dns_cache_expire(const char *hostname) {
+  (void)k_mutex_lock(&dns_cache_mutex, K_FOREVER);
+
+  DnsEntry *entry = find_entry(hostname);
+
+  if (entry != NULL) {
+    entry->expires = 0;
+  }
+
+  (void)k_mutex_unlock(&dns_cache_mutex);
+}
@@ -0,0 +1,58 @@
+/** @file dns_cache.h
+ *  @brief Cache of resolved host addresses.
+ *
+ *  Keeps the addresses of the few hosts the board talks to (stop, FOTA and
+ *  NTP servers) in static storage for CONFIG_DNS_CACHE_TTL_SECONDS, so most
+ *  requests skip the DNS round trip and getaddrinfo()'s heap allocation. If
+ *  DNS fails, the last known addresses are used until a lookup succeeds.
+ */
+
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/net/socket.h>
+
+/** connect_ms of an address that hasn't been connected to yet */
+#define DNS_CONNECT_MS_UNKNOWN (INT32_MAX - 1)
+/** connect_ms of an address the last connection to failed */
+#define DNS_CONNECT_MS_FAILED INT32_MAX
+
+/** An address of a host, with the port of the request */
+typedef struct DnsAddr {
+  struct sockaddr_storage addr;
+  socklen_t len;
+  /** Smoothed time connections to the address took */
+  int32_t connect_ms;
+} DnsAddr;
+
+/** Addresses of a host, the fastest to connect to first. Addresses not
+ *  connected to yet keep the resolver's order, alternating families. */
+typedef struct DnsAddrs {
+  size_t count;
+  DnsAddr addrs[CONFIG_DNS_CACHE_MAX_ADDRS];
+} DnsAddrs;
+
+/** @brief Resolves hostname, from the cache while its entry is fresh.
+ *
+ *  @param port Port set in each address returned.
+ *  @param addrs Set to a copy of the host's addresses.
+ *  @return 0, or the getaddrinfo() error if the lookup failed and the host
+ *  was never resolved.
+ */
+int dns_cache_resolve(const char *hostname, uint16_t port, DnsAddrs *addrs);
+
+/** @brief Records how long connecting to an address of hostname took, to
+ *  order the addresses the next time it is resolved.
+ *
+ *  @param connect_ms The connection time, or DNS_CONNECT_MS_FAILED.
+ */
+void dns_cache_report(const char *hostname, const DnsAddr *addr, int32_t connect_ms);
+
+/** @brief Makes the next dns_cache_resolve() of hostname look it up again,
+ *  for when none of its addresses could be reached. The addresses are still
+ *  kept in case DNS fails. */
+void dns_cache_expire(const char *hostname);
+
+#endif  // DNS_CACHE_H
@@ -11,11 +11,29 @@
 #include "pm_config.h"
 
 #ifdef CONFIG_JES_FOTA
+#include <stdbool.h>
 #include <string.h>
 #include <sys/errno.h>
 #include <zephyr/dfu/flash_img.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/sys/util.h>
 
+#ifdef CONFIG_JES_FOTA_DELTA
+#include <zephyr/sys/byteorder.h>
+
+#include "net/delta_patch.h"
+#endif  // CONFIG_JES_FOTA_DELTA
+
+#ifdef CONFIG_JES_FOTA_HASH_STREAM
+#include <psa/crypto.h>
+#endif  // CONFIG_JES_FOTA_HASH_STREAM
+
+#ifdef CONFIG_JES_FOTA_RESUME
+#include <zephyr/settings/settings.h>
+#include <zephyr/storage/stream_flash.h>
+#endif  // CONFIG_JES_FOTA_RESUME
+
+#include "arena.h"
 #include "net/custom_http_client.h"
 #include "watchdog_app.h"
 #endif  // CONFIG_JES_FOTA
@@ -26,26 +44,30 @@ LOG_MODULE_REGISTER(fota);
 #define STRINGIZE_VALUE(arg) STRINGIZE(arg)
 #define PM_MCUBOOT_SECONDARY_STRING STRINGIZE_VALUE(PM_MCUBOOT_SECONDARY_NAME)
 
-#define CONTENT_LENGTH_HEADER ""
-#define SHA256_HEADER "sha-256: "
-
 BUILD_ASSERT(
     FIXED_PARTITION_EXISTS(PM_MCUBOOT_SECONDARY_NAME),
     "Missing " PM_MCUBOOT_SECONDARY_STRING
     " fixed partition. Secondary slot partition is required!"
 );
 
-void validate_image(void) {
-  int rc;
-  char buf[BOOT_IMG_VER_STRLEN_MAX];
+/** Writes the version of the running image, from its MCUboot header, to buf
+ *  of BOOT_IMG_VER_STRLEN_MAX bytes. */
+static void running_version(char *buf) {
   struct mcuboot_img_header header;
 
   boot_read_bank_header(PM_MCUBOOT_PRIMARY_ID, &header, sizeof(header));
   snprintk(
-      buf, sizeof(buf), "%d.%d.%d-%d", header.h.v1.sem_ver.major,
+      buf, BOOT_IMG_VER_STRLEN_MAX, "%d.%d.%d-%d", header.h.v1.sem_ver.major,
       header.h.v1.sem_ver.minor, header.h.v1.sem_ver.revision,
       header.h.v1.sem_ver.build_num
   );
+}
+
+void validate_image(void) {
+  int rc;
+  char buf[BOOT_IMG_VER_STRLEN_MAX];
+
+  running_version(buf);
   LOG_INF("MCUboot swap type: %d", mcuboot_swap_type());
   LOG_INF("Image Version %s", buf);
   rc = boot_is_img_confirmed();
@@ -63,80 +85,740 @@ void validate_image(void) {
 
 struct flash_img_context ctx;
 
-int write_buffer_to_flash(char *data, size_t len, _Bool flush) {
-  int rc;
-  if (flush) {
-    rc = flash_img_buffered_write(&ctx, data, len, true);
+/** A block of the image handed to the flash writer */
+typedef struct FotaBlock {
+  char *data;
+  size_t len;
+  bool flush;
+} FotaBlock;
+
+/** The two blocks the image is double buffered in, one is filled from the
+ *  body as the other is written to flash */
+static char *blocks[2];
+/** The block being filled, NULL when both are with the writer */
+static char *filling;
+static size_t filling_len;
+static size_t next_block;
+
+/** Blocks free to be filled */
+static struct k_sem free_blocks;
+K_MSGQ_DEFINE(fota_block_msgq, sizeof(FotaBlock), ARRAY_SIZE(blocks), 4);
+
+/** The first error the writer got, later blocks are dropped */
+static atomic_t writer_err;
+
+/** The image being downloaded, saved to settings so the download can resume
+ *  after a reset */
+static struct {
+  /** Validators of the firmware file, sent in If-Range when resuming */
+  HttpCache validators;
+  /** The sha-256 header, empty if the server didn't send one */
+  char sha256[65];
+} image;
+
+/** Headers of the response being written, checked before its first byte */
+static const HttpHeaders *response;
+static bool response_checked;
+/** Set if the image changed since the download it resumes */
+static bool image_changed;
+/** Bytes of the image already in flash when the download started */
+static long resume_offset;
+
+enum fota_body {
+  /** A patch may have been sent instead of the image, until its start
+   *  arrives */
+  FOTA_BODY_UNKNOWN,
+  FOTA_BODY_IMAGE,
+  FOTA_BODY_PATCH,
+};
+
+static enum fota_body body;
+
+#ifdef CONFIG_JES_FOTA_DELTA
+/** Where patches from the running image are requested */
+static char delta_path[sizeof(CONFIG_JES_FOTA_PATH "?from=") + BOOT_IMG_VER_STRLEN_MAX];
+static DeltaPatch patch;
+/** The start of the body, until it tells a patch from an image */
+static char magic[4];
+static size_t magic_len;
+/** Set if the patch couldn't be applied */
+static bool patch_failed;
+#endif  // CONFIG_JES_FOTA_DELTA
+
+#ifdef CONFIG_JES_FOTA_RESUME
+
+#define FOTA_PROGRESS_KEY "fota/progress"
+
+/** Bytes written when progress was last saved */
+static size_t checkpoint;
+
+static int fota_set(const char *key, size_t len, settings_read_cb read_cb, void *cb_arg) {
+  /* The write progress is loaded by stream_flash */
+  if ((strcmp(key, "image") != 0) || (len != sizeof(image))) {
+    return 0;
+  }
+
+  if (read_cb(cb_arg, &image, sizeof(image)) != sizeof(image)) {
+    (void)memset(&image, 0, sizeof(image));
+    return -EINVAL;
+  }
+  image.validators.etag[HTTP_ETAG_SIZE - 1] = '\0';
+  image.validators.last_modified[HTTP_LAST_MODIFIED_SIZE - 1] = '\0';
+  /* Uptime of a previous boot */
+  image.validators.expires = 0;
+  image.sha256[sizeof(image.sha256) - 1] = '\0';
+  return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(fota, "fota", NULL, fota_set, NULL, NULL);
+
+/** @brief Loads how much of which image was written before a reset.
+ *
+ *  @return The number of bytes to resume from, 0 if the download starts over.
+ */
+static long load_progress(void) {
+  int err = settings_subsys_init();
+
+  (void)memset(&image, 0, sizeof(image));
+  if (err == 0) {
+    err = settings_load_subtree("fota");
+  }
+  if (err == 0) {
+    err = stream_flash_progress_load(&ctx.stream, FOTA_PROGRESS_KEY);
+  }
+  if (err) {
+    LOG_ERR("Failed to load the download progress. Err: %d", err);
+    return 0;
+  }
+
+  checkpoint = flash_img_bytes_written(&ctx);
+  /* If-Range needs a validator to tell the image hasn't changed */
+  if ((image.validators.etag[0] == '\0') && (image.validators.last_modified[0] == '\0')) {
+    return 0;
+  }
+  return checkpoint;
+}
+
+/** Saves the write progress every CONFIG_JES_FOTA_CHECKPOINT_SIZE bytes.
+ *
+ *  @param force Whether to save it however little was written since.
+ */
+static void save_progress(bool force) {
+  const size_t written = ctx.stream.bytes_written;
+
+  /* A download resumes from an offset in the body, which for a patch isn't
+   * an offset in the image */
+  if ((body == FOTA_BODY_PATCH) || (written == checkpoint) ||
+      (!force && ((written - checkpoint) < CONFIG_JES_FOTA_CHECKPOINT_SIZE))) {
+    return;
+  }
+
+  const int err = stream_flash_progress_save(&ctx.stream, FOTA_PROGRESS_KEY);
+  if (err) {
+    LOG_ERR("Failed to save the download progress. Err: %d", err);
   } else {
-    rc = flash_img_buffered_write(&ctx, data, len, false);
+    checkpoint = written;
+  }
+}
+
+static void save_image(void) {
+  const int err = settings_save_one("fota/image", &image, sizeof(image));
+
+  if (err) {
+    LOG_ERR("Failed to save the image being downloaded. Err: %d", err);
+  }
+}
+
+/** Forgets the download, the next one starts over. */
+static void clear_progress(void) {
+  int err = stream_flash_progress_clear(&ctx.stream, FOTA_PROGRESS_KEY);
+
+  if (err == 0) {
+    err = settings_delete("fota/image");
+  }
+  if (err) {
+    LOG_ERR("Failed to clear the download progress. Err: %d", err);
+  }
+  checkpoint = 0;
+}
+
+#else
+
+static long load_progress(void) {
+  (void)memset(&image, 0, sizeof(image));
+  return 0;
+}
+static void save_progress(bool force) {}
+static void save_image(void) {}
+static void clear_progress(void) {}
+
+#endif  // CONFIG_JES_FOTA_RESUME
+
+/** Checks the response continues the image being written, or remembers which
+ *  image a new download is of.
+ *
+ *  @return 0, or -ESTALE if the image changed.
+ */
+static int check_response(void) {
+  const char *sha256 = response->values[HTTP_HEADER_SHA256];
+
+  response_checked = true;
+
+  if (resume_offset == 0) {
+    /* The validators were just taken from the response headers */
+    image.sha256[0] = '\0';
+    if ((sha256 != NULL) && (strlen(sha256) < sizeof(image.sha256))) {
+      (void)strcpy(image.sha256, sha256);
+    }
+    save_image();
+  } else if ((sha256 != NULL) && (image.sha256[0] != '\0') && (strcmp(sha256, image.sha256) != 0)) {
+    LOG_WRN("Image changed since %ld bytes of it were written", resume_offset);
+    image_changed = true;
+    return -ESTALE;
+  }
+  return 0;
+}
+
+#ifdef CONFIG_JES_FOTA_HASH_STREAM
+
+/** sha-256 of the image written so far */
+static psa_hash_operation_t hash_op = PSA_HASH_OPERATION_INIT;
+/** Set if hashing failed, the image is then hashed again from flash */
+static bool hash_failed;
+
+static void hash_update(const char *data, size_t len) {
+  if (hash_failed || (len == 0)) {
+    return;
+  }
+
+  const psa_status_t status = psa_hash_update(&hash_op, (const uint8_t *)data, len);
+  if (status != PSA_SUCCESS) {
+    LOG_ERR("psa_hash_update() failed. Err: %d", status);
+    hash_failed = true;
+  }
+}
+
+/** @brief Starts hashing the image, from the part of it already in flash when
+ *  a download is resumed.
+ *
+ *  @param buf Read into, CONFIG_IMG_BLOCK_BUF_SIZE bytes.
+ */
+static void hash_start(char *buf) {
+  const struct flash_area *fa;
+  psa_status_t status = psa_crypto_init();
+
+  (void)psa_hash_abort(&hash_op);
+  hash_failed = false;
+  if (status == PSA_SUCCESS) {
+    status = psa_hash_setup(&hash_op, PSA_ALG_SHA_256);
+  }
+  if (status != PSA_SUCCESS) {
+    LOG_ERR("Failed to start hashing the image. Err: %d", status);
+    hash_failed = true;
+    return;
+  }
+
+  if (resume_offset == 0) {
+    return;
+  }
+  if (flash_area_open(PM_MCUBOOT_SECONDARY_ID, &fa) != 0) {
+    hash_failed = true;
+    return;
+  }
+  for (long offset = 0; (offset < resume_offset) && !hash_failed;
+       offset += CONFIG_IMG_BLOCK_BUF_SIZE) {
+    const size_t len = MIN(CONFIG_IMG_BLOCK_BUF_SIZE, resume_offset - offset);
+
+    if (flash_area_read(fa, offset, buf, len) != 0) {
+      LOG_ERR("Failed to read back %zu bytes at %ld", len, offset);
+      hash_failed = true;
+    } else {
+      hash_update(buf, len);
+    }
+  }
+  flash_area_close(fa);
+}
+
+/** @brief Finishes hashing the image.
+ *
+ *  @return 0, or -EIO if hashing failed along the way.
+ */
+static int hash_finish(uint8_t digest[32]) {
+  size_t len;
+
+  if (!hash_failed &&
+      (psa_hash_finish(&hash_op, digest, 32, &len) == PSA_SUCCESS) && (len == 32)) {
+    return 0;
+  }
+  (void)psa_hash_abort(&hash_op);
+  return -EIO;
+}
+
+static void hash_abort(void) {
+  (void)psa_hash_abort(&hash_op);
+}
+
+#else
+
+static void hash_update(const char *data, size_t len) {}
+static void hash_start(char *buf) {}
+static int hash_finish(uint8_t digest[32]) {
+  return -ENOTSUP;
+}
+static void hash_abort(void) {}
+
+#endif  // CONFIG_JES_FOTA_HASH_STREAM
+
+static void fota_writer(void *p1, void *p2, void *p3) {
+  FotaBlock block;
+  int rc;
+
+  while (true) {
+    (void)k_msgq_get(&fota_block_msgq, &block, K_FOREVER);
+
+    /* With CONFIG_IMG_ERASE_PROGRESSIVELY each sector is erased as the
+     * write pointer reaches it */
+    if (atomic_get(&writer_err) == 0) {
+      rc = flash_img_buffered_write(&ctx, (const uint8_t *)block.data, block.len, block.flush);
+      if (rc < 0) {
+        LOG_ERR("flash_img_buffered_write() failed. Err: %d", rc);
+        (void)atomic_cas(&writer_err, 0, rc);
+      } else {
+        hash_update(block.data, block.len);
+        save_progress(false);
+      }
+    }
+
+    LOG_DBG("Flash img bytes written: %d", flash_img_bytes_written(&ctx));
+
+    rc = wdt_feed(wdt, wdt_channel_id);
+    if (rc) {
+      LOG_ERR("Failed to feed watchdog. Err: %d", rc);
+    }
+
+    k_sem_give(&free_blocks);
+  }
+}
+
+K_THREAD_DEFINE(
+    fota_writer_tid, CONFIG_JES_FOTA_WRITER_STACK_SIZE, fota_writer, NULL, NULL, NULL,
+    CONFIG_JES_FOTA_WRITER_PRIORITY, 0, 0
+);
+
+#ifdef CONFIG_JES_FOTA_STACK_STATS
+/** Logs how close the writer thread came to the end of its stack. */
+static void log_writer_stack(void) {
+  size_t stack_unused = 0;
+
+  (void)k_thread_stack_space_get(fota_writer_tid, &stack_unused);
+  LOG_INF(
+      "FOTA writer stack high-water: %u/%u", CONFIG_JES_FOTA_WRITER_STACK_SIZE - stack_unused,
+      CONFIG_JES_FOTA_WRITER_STACK_SIZE
+  );
+}
+#else
+static void log_writer_stack(void) {}
+#endif  // CONFIG_JES_FOTA_STACK_STATS
+
+static void submit_block(bool flush) {
+  const FotaBlock block = {.data = filling, .len = filling_len, .flush = flush};
+
+  /* The queue holds as many blocks as there are, so this never waits */
+  (void)k_msgq_put(&fota_block_msgq, &block, K_FOREVER);
+  filling = NULL;
+}
+
+/** Takes the next block to fill, waiting for the writer to free one. */
+static void take_block(void) {
+  (void)k_sem_take(&free_blocks, K_FOREVER);
+  filling = blocks[next_block];
+  filling_len = 0;
+  next_block = (next_block + 1) % ARRAY_SIZE(blocks);
+}
+
+/** @brief Sets up the pipeline to write the image from the start.
+ *
+ *  @param buf Two CONFIG_IMG_BLOCK_BUF_SIZE blocks, kept until the image is
+ *  flushed.
+ */
+static void start_pipeline(char *buf) {
+  for (size_t i = 0; i < ARRAY_SIZE(blocks); i++) {
+    blocks[i] = &buf[i * CONFIG_IMG_BLOCK_BUF_SIZE];
+  }
+  filling = NULL;
+  next_block = 0;
+  atomic_set(&writer_err, 0);
+  k_msgq_purge(&fota_block_msgq);
+  k_sem_init(&free_blocks, ARRAY_SIZE(blocks), ARRAY_SIZE(blocks));
+}
+
+/** @brief Hands the block being filled to the writer and waits for it to be
+ *  written.
+ *
+ *  @param flush Whether the image is complete. Otherwise what is left in the
+ *  flash_img buffer stays unwritten, so a resumed download continues from an
+ *  aligned offset.
+ *  @return 0, or the first error the writer got.
+ */
+static int finish_pipeline(bool flush) {
+  if (filling == NULL) {
+    take_block();
+  }
+  submit_block(flush);
+
+  /* Wait for the writer to hand both blocks back */
+  for (size_t i = 0; i < ARRAY_SIZE(blocks); i++) {
+    (void)k_sem_take(&free_blocks, K_FOREVER);
+  }
+  for (size_t i = 0; i < ARRAY_SIZE(blocks); i++) {
+    k_sem_give(&free_blocks);
+  }
+  log_writer_stack();
+
+  return (int)atomic_get(&writer_err);
+}
+
+/** Copies len bytes of the image into the blocks, handing each full one to
+ *  the writer. */
+static int queue_image(const char *data, size_t len) {
+  size_t n;
+
+  while (len > 0) {
+    if (atomic_get(&writer_err) != 0) {
+      break;
+    }
+    if (filling == NULL) {
+      take_block();
+    }
+
+    n = MIN(len, CONFIG_IMG_BLOCK_BUF_SIZE - filling_len);
+    (void)memcpy(&filling[filling_len], data, n);
+    filling_len += n;
+    data += n;
+    len -= n;
+
+    if (filling_len == CONFIG_IMG_BLOCK_BUF_SIZE) {
+      submit_block(false);
+    }
   }
 
-  LOG_DBG("Flash img bytes written: %d", flash_img_bytes_written(&ctx));
+  return (int)atomic_get(&writer_err);
+}
+
+#ifdef CONFIG_JES_FOTA_DELTA
+
+/** Applies the patch from the running image, which stays in the primary slot
+ *  until MCUboot swaps the new one in. */
+static int start_patch(void) {
+  const struct flash_area *primary;
+  int rc = flash_area_open(PM_MCUBOOT_PRIMARY_ID, &primary);
 
-  rc = wdt_feed(wdt, wdt_channel_id);
   if (rc) {
-    LOG_ERR("Failed to feed watchdog. Err: %d", rc);
+    LOG_ERR("Failed to open the primary slot. Err: %d", rc);
+    return rc;
+  }
+  /* The image the patch makes is only ever checked against the sha-256 the
+   * patch came with, the whole image may come with one */
+  if (image.sha256[0] == '\0') {
+    LOG_ERR("sha-256 not found in the patch's headers");
+    flash_area_close(primary);
+    patch_failed = true;
+    return -EBADMSG;
+  }
+
+  LOG_INF("Applying a patch from the running image");
+  body = FOTA_BODY_PATCH;
+  /* The image saved as being downloaded is the one the patch makes */
+  clear_progress();
+  delta_patch_init(&patch, primary, queue_image);
+  return delta_patch_write(&patch, magic, sizeof(magic));
+}
+
+/** Tells a patch from an image by its first bytes, then passes the body on to
+ *  the patch or the pipeline. */
+static int write_body(const char *data, size_t len) {
+  size_t n;
+  int rc = 0;
+
+  if (body == FOTA_BODY_UNKNOWN) {
+    n = MIN(len, sizeof(magic) - magic_len);
+    (void)memcpy(&magic[magic_len], data, n);
+    magic_len += n;
+    data += n;
+    len -= n;
+    if (magic_len < sizeof(magic)) {
+      return 0;
+    }
+
+    if (sys_get_le32((const uint8_t *)magic) == DELTA_PATCH_MAGIC) {
+      rc = start_patch();
+    } else {
+      body = FOTA_BODY_IMAGE;
+      rc = queue_image(magic, sizeof(magic));
+    }
   }
 
+  if (rc == 0) {
+    rc = (body == FOTA_BODY_PATCH) ? delta_patch_write(&patch, data, len) : queue_image(data, len);
+  }
+  if ((rc != 0) && (body == FOTA_BODY_PATCH) && (atomic_get(&writer_err) == 0)) {
+    patch_failed = true;
+  }
   return rc;
 }
 
+static void close_patch(void) {
+  if (body == FOTA_BODY_PATCH) {
+    flash_area_close(patch.source);
+  }
+}
+
+/** Whether the body ended as it should, as a whole patch or an image. */
+static bool body_complete(void) {
+  if (body == FOTA_BODY_UNKNOWN) {
+    /* Too short to be a patch */
+    body = FOTA_BODY_IMAGE;
+    return queue_image(magic, magic_len) == 0;
+  } else if ((body == FOTA_BODY_PATCH) && !delta_patch_done(&patch)) {
+    LOG_ERR("Patch ended before the end of the image");
+    patch_failed = true;
+    return false;
+  }
+  return true;
+}
+
+#else
+
+static int write_body(const char *data, size_t len) {
+  return queue_image(data, len);
+}
+
+static bool body_complete(void) {
+  return true;
+}
+
+static void close_patch(void) {}
+
+#endif  // CONFIG_JES_FOTA_DELTA
+
+int write_buffer_to_flash(const char *data, size_t len, _Bool flush) {
+  int rc;
+
+  if ((len > 0) && !response_checked) {
+    rc = check_response();
+    if (rc) {
+      return rc;
+    }
+  }
+
+  rc = write_body(data, len);
+  if (rc) {
+    return rc;
+  }
+
+  if (flush) {
+    return finish_pipeline(true);
+  }
+  return (int)atomic_get(&writer_err);
+}
+
+/** @brief Starts writing the image to the secondary slot, from where the
+ *  last download got to if it can be resumed.
+ *
+ *  @param resume Whether to resume the last download or, if there is none,
+ *  ask for a patch from the running image. Otherwise the whole image is
+ *  downloaded from the start.
+ */
+static int start_download(char *block_buf, bool resume) {
+  int rc = flash_img_init_id(&ctx, PM_MCUBOOT_SECONDARY_ID);
+
+  if (rc < 0) {
+    LOG_ERR("Failed to init stream flash. Err: %d", rc);
+    return rc;
+  }
+
+  resume_offset = resume ? load_progress() : 0;
+  if (resume_offset > 0) {
+    LOG_INF("Resuming the download from %ld bytes", resume_offset);
+  } else {
+    clear_progress();
+    /* The progress loaded may have moved the write pointer */
+    rc = flash_img_init_id(&ctx, PM_MCUBOOT_SECONDARY_ID);
+    if (rc < 0) {
+      LOG_ERR("Failed to init stream flash. Err: %d", rc);
+      return rc;
+    }
+    http_cache_clear(&image.validators);
+
+    if (!IS_ENABLED(CONFIG_IMG_ERASE_PROGRESSIVELY)) {
+      rc = boot_erase_img_bank(PM_MCUBOOT_SECONDARY_ID);
+      if (rc < 0) {
+        LOG_ERR("Failed to erase secondary image bank");
+      }
+    }
+  }
+
+  response_checked = false;
+  image_changed = false;
+  body = FOTA_BODY_IMAGE;
+#ifdef CONFIG_JES_FOTA_DELTA
+  magic_len = 0;
+  patch_failed = false;
+  if (resume && (resume_offset == 0)) {
+    char version[BOOT_IMG_VER_STRLEN_MAX];
+
+    running_version(version);
+    (void)snprintf(delta_path, sizeof(delta_path), CONFIG_JES_FOTA_PATH "?from=%s", version);
+    body = FOTA_BODY_UNKNOWN;
+  }
+#endif  // CONFIG_JES_FOTA_DELTA
+  /* Both blocks are free until the pipeline starts */
+  hash_start(block_buf);
+  start_pipeline(block_buf);
+  return 0;
+}
+
+/** Requests the image, or a patch to it if start_download() asked for one */
+static int request_image(char *write_buf, char *headers_buf, int headers_buf_size) {
+  char *path = CONFIG_JES_FOTA_PATH;
+
+#ifdef CONFIG_JES_FOTA_DELTA
+  if (body == FOTA_BODY_UNKNOWN) {
+    path = delta_path;
+  }
+#endif  // CONFIG_JES_FOTA_DELTA
+
+  /* Patches compress well, images hardly at all */
+  return http_get_firmware(
+      path, body == FOTA_BODY_UNKNOWN, write_buf, CONFIG_IMG_BLOCK_BUF_SIZE, headers_buf,
+      headers_buf_size, (HttpHeaders *)response, &image.validators, resume_offset
+  );
+}
+
+/** Whether to download the whole image after a patch failed to apply */
+static bool patch_unusable(void) {
+#ifdef CONFIG_JES_FOTA_DELTA
+  return patch_failed;
+#else
+  return false;
+#endif  // CONFIG_JES_FOTA_DELTA
+}
+
 void download_update(void) {
   int rc;
+  int err;
 
   char headers_buf[1024];
-  char write_buf[CONFIG_IMG_BLOCK_BUF_SIZE];
+  HttpHeaders headers = {0};
   char *sha256_ptr;
   uint8_t sha256[32];
+  uint8_t digest[32];
 
-  rc = boot_erase_img_bank(PM_MCUBOOT_SECONDARY_ID);
-  if (rc < 0) {
-    LOG_ERR("Failed to erase secondary image bank");
+  const size_t mark = arena_mark();
+  char *write_buf = arena_alloc(CONFIG_IMG_BLOCK_BUF_SIZE);
+  char *block_buf = arena_alloc(2 * CONFIG_IMG_BLOCK_BUF_SIZE);
+  if ((write_buf == NULL) || (block_buf == NULL)) {
+    arena_release(mark);
+    return;
   }
 
-  rc = flash_img_init_id(&ctx, PM_MCUBOOT_SECONDARY_ID);
-  if (rc < 0) {
-    LOG_ERR("Failed to init stream flash");
+  response = &headers;
+  rc = start_download(block_buf, true);
+  if (rc == 0) {
+    rc = request_image(write_buf, headers_buf, sizeof(headers_buf));
+  }
+  if ((rc == 0) && !body_complete()) {
+    rc = -EIO;
+  }
+  if ((rc == HTTP_RANGE_IGNORED) || patch_unusable()) {
+    if (rc == HTTP_RANGE_IGNORED) {
+      LOG_WRN("Image changed since %ld bytes of it were written, starting over", resume_offset);
+    } else {
+      LOG_WRN("Patch couldn't be applied, downloading the whole image");
+    }
+    close_patch();
+    rc = finish_pipeline(false);
+    if (rc == 0) {
+      rc = start_download(block_buf, false);
+    }
+    if (rc == 0) {
+      rc = request_image(write_buf, headers_buf, sizeof(headers_buf));
+    }
   }
+  close_patch();
 
-  (void)http_get_firmware(
-      write_buf, sizeof(write_buf), headers_buf, sizeof(headers_buf)
-  );
+  if (rc != 0) {
+    err = finish_pipeline(false);
+    arena_release(mark);
+    LOG_ERR("Failed to download the image. Err: %d", rc);
+    hash_abort();
+    if ((err < 0) || image_changed || (body == FOTA_BODY_PATCH)) {
+      /* What was written may be corrupt or of another image */
+      clear_progress();
+    } else if (IS_ENABLED(CONFIG_JES_FOTA_RESUME) && (ctx.stream.bytes_written > 0)) {
+      /* What is left in the flash_img buffer is downloaded again */
+      save_progress(true);
+      LOG_INF("The download resumes from %zu bytes", ctx.stream.bytes_written);
+    }
+    return;
+  }
+
+  /* Flush the block being filled and whatever is left in the flash_img
+   * buffer, then wait for the writer to finish */
+  err = write_buffer_to_flash(write_buf, 0, true);
+  arena_release(mark);
+  if (err < 0) {
+    LOG_ERR("write_buffer_to_flash() failed. Err: %d", err);
+    hash_abort();
+    clear_progress();
+    return;
+  }
+
+  /* Whether the image checks out or not, it isn't resumed */
+  clear_progress();
 
   LOG_DBG("mcuboot_swap_type: %d", mcuboot_swap_type());
 
-  sha256_ptr = strstr(headers_buf, SHA256_HEADER);
+  /* A resumed download's range response may leave the header out, the
+   * first response's was saved with the image */
+  sha256_ptr = headers.values[HTTP_HEADER_SHA256];
   if (sha256_ptr == NULL) {
-    LOG_WRN("sha-256 not found in headers");
+    sha256_ptr = image.sha256;
+  }
+  if (*sha256_ptr == '\0') {
+    LOG_ERR("sha-256 not found in headers, not upgrading to an unchecked image");
+    hash_abort();
+    return;
+  }
 
-    rc = boot_request_upgrade(BOOT_UPGRADE_TEST);
-    if (rc < 0) {
-      LOG_ERR("Failed to REQUEST FIRMWARE UPGRADE");
-    }
-  } else {
-    sha256_ptr += (sizeof(SHA256_HEADER) - 1);
+  rc = hex2bin(sha256_ptr, strlen(sha256_ptr), sha256, sizeof(sha256));
+  if (rc != sizeof(sha256)) {
+    LOG_ERR("hex2bin failed: %d", rc);
+    hash_abort();
+    return;
+  }
 
-    rc = hex2bin(sha256_ptr, 64, sha256, 32);
-    if (rc != 32) {
-      LOG_ERR("hex2bin failed: %d", rc);
+  if (hash_finish(digest) == 0) {
+    /* Hashed as it was written, rather than read back from flash */
+    if (memcmp(digest, sha256, sizeof(sha256)) != 0) {
+      LOG_ERR("sha-256 of the image doesn't match");
+      return;
     }
-
-    struct flash_img_check fic = {
-        .match = sha256, .clen = flash_img_bytes_written(&ctx)
-    };
+  } else {
+    struct flash_img_check fic = {.match = sha256, .clen = flash_img_bytes_written(&ctx)};
 
     rc = flash_img_check(&ctx, &fic, PM_MCUBOOT_SECONDARY_ID);
     if (rc < 0) {
       LOG_ERR("flash_img_check failed: %s (%d)", strerror(rc), rc);
       return;
     }
+  }
 
-    LOG_DBG("Image check sucessful!");
+  LOG_DBG("Image check sucessful!");
 
-    rc = boot_request_upgrade(BOOT_UPGRADE_TEST);
-    if (rc < 0) {
-      LOG_ERR("Failed to REQUEST FIRMWARE UPGRADE");
-    }
+  rc = boot_request_upgrade(BOOT_UPGRADE_TEST);
+  if (rc < 0) {
+    LOG_ERR("Failed to REQUEST FIRMWARE UPGRADE");
   }
 }
 
@@ -4,7 +4,16 @@
 #ifdef CONFIG_JES_FOTA
 #include <zephyr/types.h>
 
-int write_buffer_to_flash(char *data, size_t len, _Bool flush);
+/** @brief Queues len bytes of the image to be written to the secondary slot.
+ *
+ *  The image is written by a thread of its own, from two blocks in turn, so
+ *  the download goes on while a block is written. Only waits when both blocks
+ *  are full. With flush set, waits until the whole image is written.
+ *
+ *  @return 0, or the first error writing to flash, after which the rest of
+ *  the image is dropped.
+ */
+int write_buffer_to_flash(const char *data, size_t len, _Bool flush);
 void download_update(void);
 #endif  // CONFIG_JES_FOTA
 
@@ -0,0 +1,58 @@
+/** @headerfile http_location.h */
+#include "net/http_location.h"
+
+#include <string.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(http_location);
+
+char *http_location_resolve(
+    char *location, const char *hostname, char *buf, size_t size, char **path, bool *tls
+) {
+  char *ptr;
+
+  /* Assume the host is the same */
+  if (*location == '/') {
+    if ((strlen(hostname) + strlen(location) + 2) > size) {
+      LOG_ERR("Redirect location too long");
+      return NULL;
+    }
+    /* The hostname may already be in buf */
+    if (hostname != buf) {
+      (void)strcpy(buf, hostname);
+    }
+    *path = strcpy(&buf[strlen(buf) + 1], location);
+    return buf;
+  }
+
+  if (strncmp(location, "https://", 8) == 0) {
+    *tls = true;
+    location += 8;
+  } else if (strncmp(location, "http://", 7) == 0) {
+    *tls = false;
+    location += 7;
+  } else {
+    LOG_ERR("Bad redirect location");
+    return NULL;
+  }
+
+  ptr = strchr(location, '/');
+  if (ptr == NULL) {
+    LOG_ERR("Redirect location has no path");
+    return NULL;
+  }
+  *ptr++ = '\0';
+
+  /* The hostname, its terminator, '/', the rest of the path and its
+   * terminator */
+  if ((strlen(location) + strlen(ptr) + 3) > size) {
+    LOG_ERR("Redirect location too long");
+    return NULL;
+  }
+
+  *path = stpcpy(buf, location) + 1;
+  **path = '/';
+  (void)strcpy(*path + 1, ptr);
+
+  return buf;
+}
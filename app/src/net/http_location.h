@@ -0,0 +1,29 @@
+/** @file http_location.h
+ *  @brief Resolving the Location of a redirect into the next request's URL.
+ */
+
+#ifndef HTTP_LOCATION_H
+#define HTTP_LOCATION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @brief Resolves location against the URL of the request it redirects.
+ *
+ *  The new hostname is written to buf, followed by the new path after its
+ *  terminator, the layout send_http_request() keeps redirects in.
+ *
+ *  @param location The Location header value, modified in place.
+ *  @param hostname Host of the redirected request, which a relative location
+ *  keeps. May already be in buf.
+ *  @param path Set to the new path, in buf.
+ *  @param tls Set to whether an absolute location is https, unchanged by a
+ *  relative one.
+ *  @return The new hostname, in buf, or NULL if location is malformed or the
+ *  URL doesn't fit in size bytes.
+ */
+char *http_location_resolve(
+    char *location, const char *hostname, char *buf, size_t size, char **path, bool *tls
+);
+
+#endif  // HTTP_LOCATION_H
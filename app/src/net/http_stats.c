@@ -0,0 +1,173 @@
+#ifdef CONFIG_HTTP_STATS
+
+/** @headerfile http_stats.h */
+#include "net/http_stats.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/stats/stats.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_REGISTER(http_stats);
+
+/** Upper bounds of the histogram buckets in ms, the last bucket counts
+ *  anything slower */
+static const uint32_t bucket_ms[] = {10, 50, 100, 250, 500, 1000, 2500, 5000};
+
+#define HTTP_STATS_BUCKETS (ARRAY_SIZE(bucket_ms) + 1)
+
+STATS_SECT_START(http_stats)
+STATS_SECT_ENTRY32(refreshes)
+STATS_SECT_ENTRY32(failures)
+STATS_SECT_ENTRY32(retries)
+STATS_SECT_ENTRY32(redirects)
+STATS_SECT_ENTRY32(rx_bytes)
+/* The stats walker reads the section as an array of counters, so the
+ * histograms can be indexed rather than named one by one */
+uint32_t histograms[HTTP_STATS_PHASE_COUNT][HTTP_STATS_BUCKETS];
+STATS_SECT_END;
+
+BUILD_ASSERT(HTTP_STATS_BUCKETS == 9, "HISTOGRAM_NAMES() must name every bucket");
+
+#define HISTOGRAM_NAME(phase, bucket, name)                                 \
+  {offsetof(STATS_SECT_DECL(http_stats), histograms[phase][bucket]), name},
+
+#define HISTOGRAM_NAMES(phase, name)        \
+  HISTOGRAM_NAME(phase, 0, name "_10ms")    \
+  HISTOGRAM_NAME(phase, 1, name "_50ms")    \
+  HISTOGRAM_NAME(phase, 2, name "_100ms")   \
+  HISTOGRAM_NAME(phase, 3, name "_250ms")   \
+  HISTOGRAM_NAME(phase, 4, name "_500ms")   \
+  HISTOGRAM_NAME(phase, 5, name "_1s")      \
+  HISTOGRAM_NAME(phase, 6, name "_2500ms")  \
+  HISTOGRAM_NAME(phase, 7, name "_5s")      \
+  HISTOGRAM_NAME(phase, 8, name "_over_5s")
+
+STATS_NAME_START(http_stats)
+STATS_NAME(http_stats, refreshes)
+STATS_NAME(http_stats, failures)
+STATS_NAME(http_stats, retries)
+STATS_NAME(http_stats, redirects)
+STATS_NAME(http_stats, rx_bytes)
+HISTOGRAM_NAMES(HTTP_STATS_DNS, "dns")
+HISTOGRAM_NAMES(HTTP_STATS_CONNECT, "connect")
+HISTOGRAM_NAMES(HTTP_STATS_TLS, "tls")
+HISTOGRAM_NAMES(HTTP_STATS_SEND, "send")
+HISTOGRAM_NAMES(HTTP_STATS_FIRST_BYTE, "first_byte")
+HISTOGRAM_NAMES(HTTP_STATS_BODY, "body")
+HISTOGRAM_NAMES(HTTP_STATS_PARSE, "parse")
+HISTOGRAM_NAMES(HTTP_STATS_RENDER, "render")
+STATS_NAME_END(http_stats);
+
+static STATS_SECT_DECL(http_stats) http_stats;
+
+/** The refresh being recorded */
+static struct {
+  bool active;
+  /** Bit per phase that ran */
+  uint16_t seen;
+  uint32_t us[HTTP_STATS_PHASE_COUNT];
+  uint32_t bytes;
+  uint16_t retries;
+  uint16_t redirects;
+} refresh;
+
+static int http_stats_init(void) {
+  int err = stats_init_and_reg(
+      STATS_HDR(http_stats), STATS_SIZE_INIT_PARMS(http_stats, STATS_SIZE_32),
+      STATS_NAME_INIT_PARMS(http_stats), "http"
+  );
+
+  if (err) {
+    LOG_ERR("Failed to register the http stats group. Err: %d", err);
+  }
+  return err;
+}
+
+SYS_INIT(http_stats_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+void http_stats_begin(void) {
+  (void)memset(&refresh, 0, sizeof(refresh));
+  refresh.active = true;
+}
+
+void http_stats_add(enum http_stats_phase phase, uint32_t us) {
+  if (!refresh.active) {
+    return;
+  }
+  refresh.us[phase] += us;
+  refresh.seen |= BIT(phase);
+}
+
+void http_stats_since(enum http_stats_phase phase, uint32_t start) {
+  http_stats_add(phase, k_cyc_to_us_floor32(k_cycle_get_32() - start));
+}
+
+void http_stats_bytes(size_t bytes) {
+  if (refresh.active) {
+    refresh.bytes += bytes;
+  }
+}
+
+void http_stats_retry(void) {
+  if (refresh.active) {
+    refresh.retries++;
+  }
+}
+
+void http_stats_redirect(void) {
+  if (refresh.active) {
+    refresh.redirects++;
+  }
+}
+
+static size_t bucket(uint32_t ms) {
+  size_t i = 0;
+
+  while ((i < ARRAY_SIZE(bucket_ms)) && (ms > bucket_ms[i])) {
+    i++;
+  }
+  return i;
+}
+
+void http_stats_end(bool failed) {
+  uint32_t ms[HTTP_STATS_PHASE_COUNT];
+
+  if (!refresh.active) {
+    return;
+  }
+  refresh.active = false;
+
+  /* The parser runs in the body callback, what is left of the body is the
+   * time spent waiting on the network */
+  refresh.us[HTTP_STATS_BODY] -= MIN(refresh.us[HTTP_STATS_PARSE], refresh.us[HTTP_STATS_BODY]);
+
+  for (size_t phase = 0; phase < HTTP_STATS_PHASE_COUNT; phase++) {
+    ms[phase] = refresh.us[phase] / USEC_PER_MSEC;
+    if (refresh.seen & BIT(phase)) {
+      http_stats.histograms[phase][bucket(ms[phase])]++;
+    }
+  }
+
+  STATS_INC(http_stats, refreshes);
+  if (failed) {
+    STATS_INC(http_stats, failures);
+  }
+  STATS_INCN(http_stats, retries, refresh.retries);
+  STATS_INCN(http_stats, redirects, refresh.redirects);
+  STATS_INCN(http_stats, rx_bytes, refresh.bytes);
+
+  LOG_INF(
+      "%s in ms, dns/connect/tls/send/first byte/body/parse/render: "
+      "%u/%u/%u/%u/%u/%u/%u/%u, %u bytes, %u retries, %u redirects",
+      failed ? "Failed refresh" : "Refresh", ms[HTTP_STATS_DNS], ms[HTTP_STATS_CONNECT],
+      ms[HTTP_STATS_TLS], ms[HTTP_STATS_SEND], ms[HTTP_STATS_FIRST_BYTE], ms[HTTP_STATS_BODY],
+      ms[HTTP_STATS_PARSE], ms[HTTP_STATS_RENDER], refresh.bytes, refresh.retries,
+      refresh.redirects
+  );
+}
+
+#endif  // CONFIG_HTTP_STATS
@@ -0,0 +1,78 @@
+/** @file http_stats.h
+ *  @brief Per-phase timing of stop refreshes.
+ *
+ *  Each stop refresh is timed phase by phase, from DNS to rendering the
+ *  departures, and the times are counted into fixed-bucket histograms in the
+ *  "http" stats group, readable with the MCUmgr stat group. Every refresh
+ *  also logs its times in one line.
+ *
+ *  Only requests made between http_stats_begin() and http_stats_end() are
+ *  recorded, so firmware downloads don't skew the histograms. Like the
+ *  arena, it is only used from the HTTP work queue.
+ */
+
+#ifndef HTTP_STATS_H
+#define HTTP_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum http_stats_phase {
+  HTTP_STATS_DNS,
+  /** Connecting a plain socket */
+  HTTP_STATS_CONNECT,
+  /** Connecting a TLS socket, the modem does the TCP and TLS handshakes in
+   *  the one connect() */
+  HTTP_STATS_TLS,
+  HTTP_STATS_SEND,
+  /** From the request being sent to its headers arriving */
+  HTTP_STATS_FIRST_BYTE,
+  /** Receiving the body, less the time parse took */
+  HTTP_STATS_BODY,
+  /** The stop parser, which runs as the body arrives */
+  HTTP_STATS_PARSE,
+  /** Writing the departures to the displays */
+  HTTP_STATS_RENDER,
+  HTTP_STATS_PHASE_COUNT,
+};
+
+#ifdef CONFIG_HTTP_STATS
+
+/** @brief Starts recording a refresh. */
+void http_stats_begin(void);
+
+/** @brief Adds us microseconds to phase of the refresh being recorded.
+ *  Phases that run more than once, such as on a retry, add up. */
+void http_stats_add(enum http_stats_phase phase, uint32_t us);
+
+/** @brief Adds the time since start, a k_cycle_get_32() value, to phase. */
+void http_stats_since(enum http_stats_phase phase, uint32_t start);
+
+/** @brief Adds bytes received, headers and framing included. */
+void http_stats_bytes(size_t bytes);
+
+void http_stats_retry(void);
+
+void http_stats_redirect(void);
+
+/** @brief Counts the recorded phases into the histograms and logs them.
+ *
+ *  @param failed Whether the refresh failed. The phases of failed refreshes
+ *  are recorded too, a timeout shows up in the phase that stalled.
+ */
+void http_stats_end(bool failed);
+
+#else
+
+static inline void http_stats_begin(void) {}
+static inline void http_stats_add(enum http_stats_phase phase, uint32_t us) {}
+static inline void http_stats_since(enum http_stats_phase phase, uint32_t start) {}
+static inline void http_stats_bytes(size_t bytes) {}
+static inline void http_stats_retry(void) {}
+static inline void http_stats_redirect(void) {}
+static inline void http_stats_end(bool failed) {}
+
+#endif  // CONFIG_HTTP_STATS
+
+#endif  // HTTP_STATS_H
@@ -0,0 +1,662 @@
+#ifdef CONFIG_HTTP_INFLATE
+
+#include "net/inflate.h"
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/crc.h>
+
+LOG_MODULE_REGISTER(inflate);
+
+enum inflate_state {
+  /** gzip member header and its optional fields */
+  INFLATE_GZIP_HEADER = 0,
+  INFLATE_GZIP_EXTRA_LEN,
+  INFLATE_GZIP_EXTRA,
+  INFLATE_GZIP_NAME,
+  INFLATE_GZIP_COMMENT,
+  INFLATE_GZIP_HCRC,
+  /** Tells a zlib header from raw deflate */
+  INFLATE_DETECT,
+  INFLATE_ZLIB_HEADER,
+  /** Header bits of the next deflate block */
+  INFLATE_BLOCK,
+  INFLATE_STORED,
+  INFLATE_STORED_NLEN,
+  INFLATE_STORED_COPY,
+  /** Dynamic block header, counts and code lengths */
+  INFLATE_TABLE,
+  INFLATE_CODELENS,
+  INFLATE_LENLENS,
+  INFLATE_LENLENS_EXTRA,
+  /** Literal/length symbols and the distance of each match */
+  INFLATE_LEN,
+  INFLATE_LEN_EXTRA,
+  INFLATE_DIST,
+  INFLATE_DIST_EXTRA,
+  INFLATE_BLOCK_END,
+  INFLATE_TRAILER,
+  INFLATE_DONE,
+};
+
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+
+static const uint16_t len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131,
+    163, 195, 227, 258
+};
+static const uint8_t len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537,
+    2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/** Order the code length code lengths are sent in */
+static const uint8_t codelen_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/** Pulls input bytes into hold until it has n bits, n is at most 16.
+ *
+ *  @return false if the input ran out first.
+ */
+static bool need_bits(Inflater *inf, unsigned int n) {
+  while (inf->bits < n) {
+    if (inf->in == inf->in_end) {
+      return false;
+    }
+    inf->hold |= (uint32_t)*inf->in++ << inf->bits;
+    inf->bits += 8;
+  }
+  return true;
+}
+
+/** Takes n bits that need_bits() made available. */
+static unsigned int take_bits(Inflater *inf, unsigned int n) {
+  const unsigned int value = inf->hold & ((1U << n) - 1);
+
+  inf->hold >>= n;
+  inf->bits -= n;
+  return value;
+}
+
+static uint32_t adler32_update(uint32_t adler, const uint8_t *data, size_t len) {
+  uint32_t a = adler & 0xFFFF;
+  uint32_t b = adler >> 16;
+
+  while (len > 0) {
+    /* 5552 bytes is the most that can be summed before b overflows */
+    size_t run = MIN(len, 5552);
+
+    len -= run;
+    while (run-- > 0) {
+      a += *data++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+
+  return (b << 16) | a;
+}
+
+/** Passes the output that hasn't been yet on to out. */
+static int flush(Inflater *inf) {
+  const size_t len = inf->pos - inf->flushed;
+  const uint8_t *data = &inf->window[inf->flushed];
+
+  if (len == 0) {
+    return 0;
+  }
+
+  if (inf->format == INFLATE_GZIP) {
+    inf->check = crc32_ieee_update(inf->check, data, len);
+  } else {
+    inf->check = adler32_update(inf->check, data, len);
+  }
+
+  inf->flushed = inf->pos;
+  return inf->out((const char *)data, len, inf->user_data);
+}
+
+static int put(Inflater *inf, uint8_t c) {
+  int rc = 0;
+
+  inf->window[inf->pos++] = c;
+  inf->total_out++;
+
+  if (inf->pos == inf->window_size) {
+    rc = flush(inf);
+    inf->pos = 0;
+    inf->flushed = 0;
+  }
+
+  return rc;
+}
+
+/** Copies a match of length bytes from distance bytes back in the window. */
+static int copy_match(Inflater *inf, unsigned int length, unsigned int distance) {
+  size_t from;
+  int rc;
+
+  if (distance > inf->total_out) {
+    LOG_ERR("Match distance %u before the start of the stream", distance);
+    return INFLATE_ERR_DATA;
+  } else if (distance > inf->window_size) {
+    LOG_ERR("Match distance %u larger than the %zu byte window", distance, inf->window_size);
+    return INFLATE_ERR_WINDOW;
+  }
+
+  from = (inf->pos >= distance) ? (inf->pos - distance) : (inf->pos + inf->window_size - distance);
+
+  while (length-- > 0) {
+    /* Overlapping matches repeat the bytes just written, so copy in order */
+    rc = put(inf, inf->window[from]);
+    if (rc) {
+      return rc;
+    }
+    if (++from == inf->window_size) {
+      from = 0;
+    }
+  }
+
+  return 0;
+}
+
+/** Builds a canonical Huffman code from the code length of each symbol. */
+static int build_huffman(uint16_t *counts, uint16_t *symbols, const uint8_t *lengths, size_t n) {
+  uint16_t offsets[16];
+  int left = 1;
+
+  (void)memset(counts, 0, 16 * sizeof(*counts));
+  for (size_t i = 0; i < n; i++) {
+    counts[lengths[i]]++;
+  }
+  counts[0] = 0;
+
+  /* Incomplete codes are allowed, over-subscribed ones aren't */
+  for (size_t len = 1; len < 16; len++) {
+    left = (left << 1) - counts[len];
+    if (left < 0) {
+      LOG_ERR("Over-subscribed Huffman code");
+      return INFLATE_ERR_DATA;
+    }
+  }
+
+  offsets[1] = 0;
+  for (size_t len = 1; len < 15; len++) {
+    offsets[len + 1] = offsets[len] + counts[len];
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    if (lengths[i] != 0) {
+      symbols[offsets[lengths[i]]++] = i;
+    }
+  }
+
+  return 0;
+}
+
+/** Decodes the next symbol, its bits are only taken once all of them have
+ *  arrived.
+ *
+ *  @return The symbol, -1 if more input is needed or INFLATE_ERR_DATA.
+ */
+static int decode_symbol(Inflater *inf, const uint16_t *counts, const uint16_t *symbols) {
+  int code = 0;
+  int first = 0;
+  int index = 0;
+
+  (void)need_bits(inf, 15);
+
+  for (unsigned int len = 1; len < 16; len++) {
+    if (len > inf->bits) {
+      return -1;
+    }
+    code |= (inf->hold >> (len - 1)) & 1;
+    if ((code - first) < counts[len]) {
+      (void)take_bits(inf, len);
+      return symbols[index + (code - first)];
+    }
+    index += counts[len];
+    first = (first + counts[len]) << 1;
+    code <<= 1;
+  }
+
+  LOG_ERR("Invalid Huffman code");
+  return INFLATE_ERR_DATA;
+}
+
+static int build_fixed(Inflater *inf) {
+  size_t i = 0;
+
+  for (; i < 144; i++) {
+    inf->lengths[i] = 8;
+  }
+  for (; i < 256; i++) {
+    inf->lengths[i] = 9;
+  }
+  for (; i < 280; i++) {
+    inf->lengths[i] = 7;
+  }
+  for (; i < 288; i++) {
+    inf->lengths[i] = 8;
+  }
+  (void)build_huffman(inf->lit.counts, inf->lit.symbols, inf->lengths, 288);
+
+  (void)memset(inf->lengths, 5, 30);
+  return build_huffman(inf->dist.counts, inf->dist.symbols, inf->lengths, 30);
+}
+
+/** Reads bytes up to and including a NUL, for the gzip name and comment. */
+static bool skip_string(Inflater *inf) {
+  while (need_bits(inf, 8)) {
+    if (take_bits(inf, 8) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static int check_trailer(Inflater *inf) {
+  const uint8_t *t = inf->trailer;
+  uint32_t check;
+
+  if (inf->format == INFLATE_GZIP) {
+    check = t[0] | (t[1] << 8) | (t[2] << 16) | ((uint32_t)t[3] << 24);
+    const uint32_t size = t[4] | (t[5] << 8) | (t[6] << 16) | ((uint32_t)t[7] << 24);
+    if (size != inf->total_out) {
+      LOG_ERR("gzip size %u doesn't match the %u bytes decoded", size, inf->total_out);
+      return INFLATE_ERR_DATA;
+    }
+  } else {
+    check = ((uint32_t)t[0] << 24) | (t[1] << 16) | (t[2] << 8) | t[3];
+  }
+
+  if (check != inf->check) {
+    LOG_ERR("Check value %08x doesn't match %08x", check, inf->check);
+    return INFLATE_ERR_DATA;
+  }
+  return 0;
+}
+
+/** Decodes as much of the input as possible.
+ *
+ *  Every state only takes its bits once they have all arrived, so running out
+ *  of input simply returns and the next chunk carries on in the same state.
+ */
+static int inflate_run(Inflater *inf) {
+  int sym;
+  int rc;
+
+  while (true) {
+    switch (inf->state) {
+      case INFLATE_GZIP_HEADER:
+        /* ID1 ID2 CM FLG MTIME(4) XFL OS */
+        while (inf->n < 10) {
+          if (!need_bits(inf, 8)) {
+            return 0;
+          }
+          const unsigned int c = take_bits(inf, 8);
+          if (((inf->n == 0) && (c != 0x1F)) || ((inf->n == 1) && (c != 0x8B)) ||
+              ((inf->n == 2) && (c != 8))) {
+            LOG_ERR("Not a gzip deflate stream");
+            return INFLATE_ERR_DATA;
+          } else if (inf->n == 3) {
+            inf->flags = c;
+          }
+          inf->n++;
+        }
+        inf->state = INFLATE_GZIP_EXTRA_LEN;
+        break;
+      case INFLATE_GZIP_EXTRA_LEN:
+        if (inf->flags & GZIP_FEXTRA) {
+          if (!need_bits(inf, 16)) {
+            return 0;
+          }
+          inf->length = take_bits(inf, 16);
+        } else {
+          inf->length = 0;
+        }
+        inf->state = INFLATE_GZIP_EXTRA;
+        break;
+      case INFLATE_GZIP_EXTRA:
+        while (inf->length > 0) {
+          if (!need_bits(inf, 8)) {
+            return 0;
+          }
+          (void)take_bits(inf, 8);
+          inf->length--;
+        }
+        inf->state = INFLATE_GZIP_NAME;
+        break;
+      case INFLATE_GZIP_NAME:
+        if ((inf->flags & GZIP_FNAME) && !skip_string(inf)) {
+          return 0;
+        }
+        inf->state = INFLATE_GZIP_COMMENT;
+        break;
+      case INFLATE_GZIP_COMMENT:
+        if ((inf->flags & GZIP_FCOMMENT) && !skip_string(inf)) {
+          return 0;
+        }
+        inf->state = INFLATE_GZIP_HCRC;
+        break;
+      case INFLATE_GZIP_HCRC:
+        if (inf->flags & GZIP_FHCRC) {
+          if (!need_bits(inf, 16)) {
+            return 0;
+          }
+          (void)take_bits(inf, 16);
+        }
+        inf->state = INFLATE_BLOCK;
+        break;
+      case INFLATE_DETECT:
+        if (!need_bits(inf, 16)) {
+          return 0;
+        }
+        /* CM 8, a window of at most 32 KB and a valid FCHECK */
+        if (((inf->hold & 0x8F) == 0x08) &&
+            (((((inf->hold & 0xFF) << 8) | ((inf->hold >> 8) & 0xFF)) % 31) == 0)) {
+          inf->state = INFLATE_ZLIB_HEADER;
+        } else {
+          LOG_DBG("Raw deflate stream");
+          inf->state = INFLATE_BLOCK;
+        }
+        break;
+      case INFLATE_ZLIB_HEADER:
+        /* Only zlib streams end with an Adler-32 */
+        inf->flags = 1;
+        (void)take_bits(inf, 8);
+        if (take_bits(inf, 8) & 0x20) {
+          LOG_ERR("zlib preset dictionaries aren't supported");
+          return INFLATE_ERR_DATA;
+        }
+        inf->state = INFLATE_BLOCK;
+        break;
+      case INFLATE_BLOCK:
+        if (!need_bits(inf, 3)) {
+          return 0;
+        }
+        inf->last_block = take_bits(inf, 1);
+        switch (take_bits(inf, 2)) {
+          case 0:
+            /* Stored blocks start on a byte boundary */
+            (void)take_bits(inf, inf->bits & 7);
+            inf->state = INFLATE_STORED;
+            break;
+          case 1:
+            (void)build_fixed(inf);
+            inf->state = INFLATE_LEN;
+            break;
+          case 2:
+            inf->state = INFLATE_TABLE;
+            break;
+          default:
+            LOG_ERR("Invalid deflate block type");
+            return INFLATE_ERR_DATA;
+        }
+        break;
+      case INFLATE_STORED:
+        if (!need_bits(inf, 16)) {
+          return 0;
+        }
+        inf->length = take_bits(inf, 16);
+        inf->state = INFLATE_STORED_NLEN;
+        break;
+      case INFLATE_STORED_NLEN:
+        if (!need_bits(inf, 16)) {
+          return 0;
+        }
+        if (take_bits(inf, 16) != (~inf->length & 0xFFFF)) {
+          LOG_ERR("Stored block length check failed");
+          return INFLATE_ERR_DATA;
+        }
+        inf->state = INFLATE_STORED_COPY;
+        break;
+      case INFLATE_STORED_COPY:
+        while (inf->length > 0) {
+          if (!need_bits(inf, 8)) {
+            return 0;
+          }
+          rc = put(inf, take_bits(inf, 8));
+          if (rc) {
+            return rc;
+          }
+          inf->length--;
+        }
+        inf->state = INFLATE_BLOCK_END;
+        break;
+      case INFLATE_TABLE:
+        if (!need_bits(inf, 14)) {
+          return 0;
+        }
+        inf->hlit = take_bits(inf, 5) + 257;
+        inf->hdist = take_bits(inf, 5) + 1;
+        inf->hclen = take_bits(inf, 4) + 4;
+        if ((inf->hlit > 286) || (inf->hdist > 30)) {
+          LOG_ERR("Too many length or distance codes");
+          return INFLATE_ERR_DATA;
+        }
+        (void)memset(inf->lengths, 0, 19);
+        inf->n = 0;
+        inf->state = INFLATE_CODELENS;
+        break;
+      case INFLATE_CODELENS:
+        while (inf->n < inf->hclen) {
+          if (!need_bits(inf, 3)) {
+            return 0;
+          }
+          inf->lengths[codelen_order[inf->n++]] = take_bits(inf, 3);
+        }
+        rc = build_huffman(inf->dist.counts, inf->dist.symbols, inf->lengths, 19);
+        if (rc) {
+          return rc;
+        }
+        inf->n = 0;
+        inf->state = INFLATE_LENLENS;
+        break;
+      case INFLATE_LENLENS:
+        while (inf->n < (inf->hlit + inf->hdist)) {
+          sym = decode_symbol(inf, inf->dist.counts, inf->dist.symbols);
+          if (sym == -1) {
+            return 0;
+          } else if (sym < 0) {
+            return sym;
+          } else if (sym >= 16) {
+            inf->sym = sym;
+            inf->state = INFLATE_LENLENS_EXTRA;
+            break;
+          }
+          inf->lengths[inf->n++] = sym;
+        }
+        if (inf->state == INFLATE_LENLENS_EXTRA) {
+          break;
+        }
+        if (inf->lengths[256] == 0) {
+          LOG_ERR("Missing end of block code");
+          return INFLATE_ERR_DATA;
+        }
+        rc = build_huffman(inf->lit.counts, inf->lit.symbols, inf->lengths, inf->hlit);
+        if (rc == 0) {
+          rc = build_huffman(
+              inf->dist.counts, inf->dist.symbols, &inf->lengths[inf->hlit], inf->hdist
+          );
+        }
+        if (rc) {
+          return rc;
+        }
+        inf->state = INFLATE_LEN;
+        break;
+      case INFLATE_LENLENS_EXTRA: {
+        /* 16 repeats the previous length 3-6 times, 17 and 18 repeat zero
+         * 3-10 and 11-138 times */
+        const unsigned int extra = (inf->sym == 16) ? 2 : ((inf->sym == 17) ? 3 : 7);
+        uint8_t value = 0;
+
+        if (!need_bits(inf, extra)) {
+          return 0;
+        }
+        unsigned int repeat = take_bits(inf, extra) + ((inf->sym == 18) ? 11 : 3);
+
+        if (inf->sym == 16) {
+          if (inf->n == 0) {
+            LOG_ERR("Repeated code length without a previous one");
+            return INFLATE_ERR_DATA;
+          }
+          value = inf->lengths[inf->n - 1];
+        }
+        if ((inf->n + repeat) > (inf->hlit + inf->hdist)) {
+          LOG_ERR("Too many code lengths");
+          return INFLATE_ERR_DATA;
+        }
+        while (repeat-- > 0) {
+          inf->lengths[inf->n++] = value;
+        }
+        inf->state = INFLATE_LENLENS;
+        break;
+      }
+      case INFLATE_LEN:
+        sym = decode_symbol(inf, inf->lit.counts, inf->lit.symbols);
+        if (sym == -1) {
+          return 0;
+        } else if (sym < 0) {
+          return sym;
+        } else if (sym < 256) {
+          rc = put(inf, sym);
+          if (rc) {
+            return rc;
+          }
+        } else if (sym == 256) {
+          inf->state = INFLATE_BLOCK_END;
+        } else if (sym < 286) {
+          inf->sym = sym - 257;
+          inf->state = INFLATE_LEN_EXTRA;
+        } else {
+          LOG_ERR("Invalid length symbol %d", sym);
+          return INFLATE_ERR_DATA;
+        }
+        break;
+      case INFLATE_LEN_EXTRA:
+        if (!need_bits(inf, len_extra[inf->sym])) {
+          return 0;
+        }
+        inf->length = len_base[inf->sym] + take_bits(inf, len_extra[inf->sym]);
+        inf->state = INFLATE_DIST;
+        break;
+      case INFLATE_DIST:
+        sym = decode_symbol(inf, inf->dist.counts, inf->dist.symbols);
+        if (sym == -1) {
+          return 0;
+        } else if ((sym < 0) || (sym >= 30)) {
+          LOG_ERR("Invalid distance symbol %d", sym);
+          return INFLATE_ERR_DATA;
+        }
+        inf->sym = sym;
+        inf->state = INFLATE_DIST_EXTRA;
+        break;
+      case INFLATE_DIST_EXTRA:
+        if (!need_bits(inf, dist_extra[inf->sym])) {
+          return 0;
+        }
+        rc = copy_match(
+            inf, inf->length, dist_base[inf->sym] + take_bits(inf, dist_extra[inf->sym])
+        );
+        if (rc) {
+          return rc;
+        }
+        inf->state = INFLATE_LEN;
+        break;
+      case INFLATE_BLOCK_END:
+        if (!inf->last_block) {
+          inf->state = INFLATE_BLOCK;
+          break;
+        }
+        /* The trailer starts on a byte boundary */
+        (void)take_bits(inf, inf->bits & 7);
+        inf->n = 0;
+        inf->state = INFLATE_TRAILER;
+        break;
+      case INFLATE_TRAILER: {
+        /* Raw deflate has no trailer, gzip a CRC-32 and the size, zlib an
+         * Adler-32 */
+        const size_t size = (inf->format == INFLATE_GZIP) ? 8 : (inf->flags ? 4 : 0);
+
+        while (inf->n < size) {
+          if (!need_bits(inf, 8)) {
+            return 0;
+          }
+          inf->trailer[inf->n++] = take_bits(inf, 8);
+        }
+        rc = flush(inf);
+        if ((rc == 0) && (size > 0)) {
+          rc = check_trailer(inf);
+        }
+        if (rc) {
+          return rc;
+        }
+        inf->state = INFLATE_DONE;
+        break;
+      }
+      case INFLATE_DONE:
+      default:
+        if ((inf->in != inf->in_end) || (inf->bits >= 8)) {
+          LOG_WRN("Ignoring data after the end of the compressed stream");
+          inf->in = inf->in_end;
+          inf->bits = 0;
+        }
+        return 0;
+    }
+  }
+}
+
+void inflater_init(
+    Inflater *inf, enum inflate_format format, uint8_t *window, size_t window_size,
+    http_body_cb_t out, void *user_data
+) {
+  (void)memset(inf, 0, offsetof(Inflater, in));
+  inf->format = format;
+  inf->state = (format == INFLATE_GZIP) ? INFLATE_GZIP_HEADER : INFLATE_DETECT;
+  /* CRC-32 starts from 0, Adler-32 from 1 */
+  inf->check = (format == INFLATE_GZIP) ? 0 : 1;
+  inf->window = window;
+  inf->window_size = window_size;
+  inf->pos = 0;
+  inf->flushed = 0;
+  inf->out = out;
+  inf->user_data = user_data;
+  inf->err = 0;
+}
+
+int inflater_feed(const char *data, size_t len, void *user_data) {
+  Inflater *inf = user_data;
+
+  if (inf->err) {
+    return inf->err;
+  }
+
+  inf->in = (const uint8_t *)data;
+  inf->in_end = inf->in + len;
+
+  inf->err = inflate_run(inf);
+  if (inf->err == 0) {
+    inf->err = flush(inf);
+  }
+
+  return inf->err;
+}
+
+bool inflater_done(const Inflater *inf) {
+  return inf->state == INFLATE_DONE;
+}
+
+#endif  // CONFIG_HTTP_INFLATE
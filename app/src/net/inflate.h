@@ -0,0 +1,103 @@
+/** @file inflate.h
+ *  @brief Streaming DEFLATE decoder for compressed HTTP responses.
+ *
+ *  Decodes gzip (RFC 1952), zlib (RFC 1950) or raw deflate (RFC 1951) data fed
+ *  in whatever chunks recv() returns. Only a window of the most recent output
+ *  is kept, so a stream can only be decoded while its matches refer back no
+ *  further than the window, which may be smaller than the 32 KB the format
+ *  allows.
+ */
+
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "net/custom_http_client.h"
+
+/** The stream is malformed or its check value doesn't match */
+#define INFLATE_ERR_DATA -1
+/** The stream refers back further than the window */
+#define INFLATE_ERR_WINDOW -2
+
+enum inflate_format {
+  INFLATE_GZIP,
+  /** zlib wrapped, or raw deflate as sent by some servers */
+  INFLATE_DEFLATE,
+};
+
+/** Canonical Huffman code, counts[len] codes of each length and the symbols
+ *  ordered by code */
+typedef struct InflateHuffman {
+  uint16_t counts[16];
+  uint16_t symbols[288];
+} InflateHuffman;
+
+/** Resumable decoder state, see inflate.c for the states. */
+typedef struct Inflater {
+  uint8_t state;
+  uint8_t format;
+  /** gzip header flags */
+  uint8_t flags;
+  bool last_block;
+  /** Bit accumulator, bits are taken from the least significant end */
+  uint32_t hold;
+  uint8_t bits;
+  /** Progress within the current state, and the symbol waiting for its extra
+   *  bits */
+  uint16_t n;
+  uint16_t sym;
+  uint16_t length;
+  uint16_t hlit;
+  uint16_t hdist;
+  uint16_t hclen;
+  /** Code lengths of the dynamic block being read */
+  uint8_t lengths[286 + 30];
+  uint8_t trailer[8];
+  InflateHuffman lit;
+  /** Distance code, also holds the code length code of a dynamic header */
+  struct {
+    uint16_t counts[16];
+    uint16_t symbols[30];
+  } dist;
+  /** CRC-32 or Adler-32 of the output, depending on the format */
+  uint32_t check;
+  uint32_t total_out;
+  /** The input chunk being decoded */
+  const uint8_t *in;
+  const uint8_t *in_end;
+  /** Recent output, window[flushed..pos) hasn't been passed on yet */
+  uint8_t *window;
+  size_t window_size;
+  size_t pos;
+  size_t flushed;
+  http_body_cb_t out;
+  void *user_data;
+  int err;
+} Inflater;
+
+/** @brief Prepares inf to decode a new stream.
+ *
+ *  @param window Buffer for the most recent output, it must stay valid until
+ *  the stream is decoded.
+ *  @param out Called with each run of decoded output.
+ */
+void inflater_init(
+    Inflater *inf, enum inflate_format format, uint8_t *window, size_t window_size,
+    http_body_cb_t out, void *user_data
+);
+
+/** @brief Decodes a chunk of the compressed stream.
+ *
+ *  @param user_data The Inflater, matches the http_body_cb_t signature so it
+ *  can sit between the HTTP client and the body consumer.
+ *  @return 0, an INFLATE_ERR_* code, or the error returned by out.
+ */
+int inflater_feed(const char *data, size_t len, void *user_data);
+
+/** @brief Whether the end of the stream, and its check value, were decoded. */
+bool inflater_done(const Inflater *inf);
+
+#endif  // INFLATE_H
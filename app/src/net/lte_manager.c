@@ -24,11 +24,22 @@ static const char jes_cert[] = {
 };
 #endif  // CONFIG_JES_FOTA || CONFIG_STOP_REQUEST_JES
 
+#ifdef CONFIG_STOP_REQUEST_BUSTRACKER_USE_TLS
+static const char bustracker_cert[] = {
+#include "bustracker-ca.pem.hex"
+    // Null terminate certificate if running Mbed TLS
+    IF_ENABLED(CONFIG_TLS_CREDENTIALS, (0x00))
+};
+#endif  // CONFIG_STOP_REQUEST_BUSTRACKER_USE_TLS
+
 #ifdef CONFIG_MODEM_KEY_MGMT
 // The total size of the included certificates must be less than 4KB
 #if defined(CONFIG_JES_FOTA) || defined(CONFIG_STOP_REQUEST_JES)
 BUILD_ASSERT(sizeof(jes_cert) < KB(4), "Certificates too large");
 #endif  // CONFIG_JES_FOTA || CONFIG_STOP_REQUEST_JES
+#ifdef CONFIG_STOP_REQUEST_BUSTRACKER_USE_TLS
+BUILD_ASSERT(sizeof(bustracker_cert) < KB(4), "Certificates too large");
+#endif  // CONFIG_STOP_REQUEST_BUSTRACKER_USE_TLS
 #endif
 
 K_SEM_DEFINE(lte_connected_sem, 1, 1);
@@ -41,7 +52,8 @@ void nrf_modem_fault_handler(struct nrf_modem_fault_info *fault_info) {
 }
 #endif
 
-#if defined(CONFIG_JES_FOTA) || defined(CONFIG_STOP_REQUEST_JES)
+#if defined(CONFIG_JES_FOTA) || defined(CONFIG_STOP_REQUEST_JES) || \
+    defined(CONFIG_STOP_REQUEST_BUSTRACKER_USE_TLS)
 /* Provision certificate to modem */
 #ifdef CONFIG_MODEM_KEY_MGMT
 static int provision_cert(nrf_sec_tag_t sec_tag, const char cert[], size_t cert_len) {
@@ -93,7 +105,7 @@ static int provision_cert(sec_tag_t sec_tag, const char cert[], size_t cert_len)
   return 0;
 }
 #endif /* !CONFIG_MODEM_KEY_MGMT */
-#endif  // CONFIG_JES_FOTA || CONFIG_STOP_REQUEST_JES
+#endif  // CONFIG_JES_FOTA || CONFIG_STOP_REQUEST_JES || CONFIG_STOP_REQUEST_BUSTRACKER_USE_TLS
 
 int lte_connect(void) {
   int err;
@@ -115,6 +127,13 @@ int lte_connect(void) {
     return err;
   }
 #endif  // CONFIG_JES_FOTA || CONFIG_STOP_REQUEST_JES
+#ifdef CONFIG_STOP_REQUEST_BUSTRACKER_USE_TLS
+  err = provision_cert(BUSTRACKER_SEC_TAG, bustracker_cert, sizeof(bustracker_cert));
+  if (err) {
+    LOG_ERR("Failed to provision TLS certificate. TLS_SEC_TAG: %d", BUSTRACKER_SEC_TAG);
+    return err;
+  }
+#endif  // CONFIG_STOP_REQUEST_BUSTRACKER_USE_TLS
 
   LOG_INF("Initializing LTE interface");
   err = wdt_feed(wdt, wdt_channel_id);
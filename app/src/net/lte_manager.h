@@ -5,7 +5,7 @@
 #define LTE_MANAGER_H
 
 extern struct k_sem lte_connected_sem;
-enum tls_sec_tags { NO_SEC_TAG, JES_SEC_TAG };
+enum tls_sec_tags { NO_SEC_TAG, JES_SEC_TAG, BUSTRACKER_SEC_TAG };
 
 /** @fn int lte_connect(void)
  *  @brief Makes an HTTP GET request and returns a char pointer to the HTTP
@@ -3,31 +3,25 @@
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
+#include "net/dns_cache.h"
+
 LOG_MODULE_REGISTER(ntp);
 
-#define SNTP_PORT "123"
+#define SNTP_PORT 123
 
 struct sntp_time time_stamp;
 
 static int ntp_request(char *url) {
   int err;
   struct sntp_ctx ctx;
+  DnsAddrs addrs;
 
-  struct zsock_addrinfo *addr_inf;
-  static struct zsock_addrinfo hints = {.ai_socktype = SOCK_DGRAM, .ai_flags = AI_NUMERICSERV};
-
-  err = zsock_getaddrinfo(url, SNTP_PORT, &hints, &addr_inf);
+  err = dns_cache_resolve(url, SNTP_PORT, &addrs);
   if (err) {
-    LOG_ERR("getaddrinfo() failed, %s", strerror(errno));
-    return errno;
-  }
-
-  if (addr_inf->ai_family == AF_INET) {
-    err = sntp_init(&ctx, addr_inf->ai_addr, sizeof(struct sockaddr_in));
-  } else {
-    err = sntp_init(&ctx, addr_inf->ai_addr, sizeof(struct sockaddr_in6));
+    return err;
   }
 
+  err = sntp_init(&ctx, (struct sockaddr *)&addrs.addrs[0].addr, addrs.addrs[0].len);
   if (err < 0) {
     LOG_ERR("Failed to init SNTP ctx: %d", err);
     goto end;
@@ -36,6 +30,8 @@ static int ntp_request(char *url) {
   err = sntp_query(&ctx, CONFIG_NTP_REQUEST_TIMEOUT_MS, &time_stamp);
   if (err) {
     LOG_ERR("SNTP request failed: %d", err);
+    /* Pools hand out a different server with each lookup */
+    dns_cache_expire(url);
   }
 
 end:
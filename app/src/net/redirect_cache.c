@@ -0,0 +1,206 @@
+#ifdef CONFIG_HTTP_REDIRECT_CACHE
+
+/** @headerfile redirect_cache.h */
+#include "net/redirect_cache.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+
+#include "real_time_counter.h"
+
+LOG_MODULE_REGISTER(redirect_cache);
+
+/** Longer URLs are redirected every time */
+#define REDIRECT_URL_SIZE 128
+
+/** A permanent redirect, saved to settings as is */
+typedef struct Redirect {
+  /** The hostname followed by the path, empty if the entry is free */
+  char from[REDIRECT_URL_SIZE];
+  char to[REDIRECT_URL_SIZE];
+  /** RTC time the redirect is forgotten at */
+  uint32_t expires;
+  bool tls;
+} Redirect;
+
+static Redirect redirects[CONFIG_HTTP_REDIRECT_CACHE_SIZE];
+
+K_MUTEX_DEFINE(redirect_cache_mutex);
+
+/** Joins hostname and path into url.
+ *
+ *  @return false if they don't fit.
+ */
+static bool join_url(char url[REDIRECT_URL_SIZE], const char *hostname, const char *path) {
+  const int len = snprintf(url, REDIRECT_URL_SIZE, "%s%s", hostname, path);
+
+  return (len > 0) && (len < REDIRECT_URL_SIZE);
+}
+
+static Redirect *find_redirect(const char *url) {
+  for (size_t i = 0; i < CONFIG_HTTP_REDIRECT_CACHE_SIZE; i++) {
+    if (strcmp(redirects[i].from, url) == 0) {
+      return &redirects[i];
+    }
+  }
+  return NULL;
+}
+
+static void save_redirect(const Redirect *redirect) {
+  char key[16];
+  int err;
+
+  (void)snprintf(key, sizeof(key), "redirect/%u", (unsigned int)(redirect - redirects));
+  if (redirect->from[0] == '\0') {
+    err = settings_delete(key);
+  } else {
+    err = settings_save_one(key, redirect, sizeof(*redirect));
+  }
+  if (err) {
+    LOG_ERR("Failed to save %s. Err: %d", key, err);
+  }
+}
+
+bool redirect_cache_lookup(
+    const char *hostname, const char *path, char *buf, size_t size, bool *tls
+) {
+  char url[REDIRECT_URL_SIZE];
+  bool found = false;
+
+  if (!join_url(url, hostname, path)) {
+    return false;
+  }
+
+  (void)k_mutex_lock(&redirect_cache_mutex, K_FOREVER);
+
+  const Redirect *redirect = find_redirect(url);
+
+  if ((redirect != NULL) && (redirect->expires > get_rtc_time())) {
+    const char *new_path = strchr(redirect->to, '/');
+    const size_t hostname_len = new_path - redirect->to;
+
+    /* The path goes after the hostname's terminator */
+    if ((hostname_len + strlen(new_path) + 2) <= size) {
+      (void)memcpy(buf, redirect->to, hostname_len);
+      buf[hostname_len] = '\0';
+      (void)strcpy(&buf[hostname_len + 1], new_path);
+      *tls = redirect->tls;
+      found = true;
+    }
+  }
+
+  (void)k_mutex_unlock(&redirect_cache_mutex);
+
+  if (found) {
+    LOG_INF("%s permanently moved to %s%s", url, buf, &buf[strlen(buf) + 1]);
+  }
+  return found;
+}
+
+void redirect_cache_store(
+    const char *hostname, const char *path, const char *new_hostname, const char *new_path,
+    bool tls
+) {
+  Redirect redirect = {.tls = tls};
+  const uint32_t now = get_rtc_time();
+
+  if (!join_url(redirect.from, hostname, path) ||
+      !join_url(redirect.to, new_hostname, new_path) || (strchr(redirect.to, '/') == NULL)) {
+    LOG_WRN("Redirect too long to cache");
+    return;
+  } else if (now == UINT32_MAX) {
+    /* The RTC couldn't be read */
+    return;
+  }
+  redirect.expires = now + (CONFIG_HTTP_REDIRECT_CACHE_TTL_HOURS * 3600U);
+
+  (void)k_mutex_lock(&redirect_cache_mutex, K_FOREVER);
+
+  Redirect *entry = find_redirect(redirect.from);
+
+  /* Otherwise take a free entry, or the one that expires first */
+  if (entry == NULL) {
+    entry = &redirects[0];
+    for (size_t i = 0; i < CONFIG_HTTP_REDIRECT_CACHE_SIZE; i++) {
+      if (redirects[i].from[0] == '\0') {
+        entry = &redirects[i];
+        break;
+      } else if (redirects[i].expires < entry->expires) {
+        entry = &redirects[i];
+      }
+    }
+  }
+
+  *entry = redirect;
+  save_redirect(entry);
+
+  (void)k_mutex_unlock(&redirect_cache_mutex);
+}
+
+void redirect_cache_forget(const char *hostname, const char *path) {
+  char url[REDIRECT_URL_SIZE];
+
+  if (!join_url(url, hostname, path)) {
+    return;
+  }
+
+  (void)k_mutex_lock(&redirect_cache_mutex, K_FOREVER);
+
+  Redirect *redirect = find_redirect(url);
+
+  if (redirect != NULL) {
+    LOG_WRN("Forgetting the redirect of %s", url);
+    (void)memset(redirect, 0, sizeof(*redirect));
+    save_redirect(redirect);
+  }
+
+  (void)k_mutex_unlock(&redirect_cache_mutex);
+}
+
+static int redirect_set(const char *key, size_t len, settings_read_cb read_cb, void *cb_arg) {
+  char *end;
+  const unsigned long i = strtoul(key, &end, 10);
+
+  if ((end == key) || (*end != '\0') || (i >= CONFIG_HTTP_REDIRECT_CACHE_SIZE) ||
+      (len != sizeof(Redirect))) {
+    /* Left by a build with a different cache, it is overwritten as
+     * redirects are stored */
+    return 0;
+  }
+
+  if (read_cb(cb_arg, &redirects[i], sizeof(Redirect)) != sizeof(Redirect)) {
+    (void)memset(&redirects[i], 0, sizeof(Redirect));
+    return -EINVAL;
+  }
+  redirects[i].from[REDIRECT_URL_SIZE - 1] = '\0';
+  redirects[i].to[REDIRECT_URL_SIZE - 1] = '\0';
+  if (strchr(redirects[i].to, '/') == NULL) {
+    (void)memset(&redirects[i], 0, sizeof(Redirect));
+  }
+  return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(redirect, "redirect", NULL, redirect_set, NULL, NULL);
+
+static int redirect_cache_init(void) {
+  int err = settings_subsys_init();
+
+  if (err == 0) {
+    err = settings_load_subtree("redirect");
+  }
+  if (err) {
+    LOG_ERR("Failed to load the cached redirects. Err: %d", err);
+  }
+  return 0;
+}
+
+SYS_INIT(redirect_cache_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#endif  // CONFIG_HTTP_REDIRECT_CACHE
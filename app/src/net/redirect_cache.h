@@ -0,0 +1,55 @@
+/** @file redirect_cache.h
+ *  @brief Permanent redirects of request URLs, kept in settings.
+ *
+ *  Where a 301 or 308 sent a request is remembered for
+ *  CONFIG_HTTP_REDIRECT_CACHE_TTL_HOURS, across restarts, so later requests
+ *  go straight to the new location instead of following the redirect on every
+ *  refresh.
+ */
+
+#ifndef REDIRECT_CACHE_H
+#define REDIRECT_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef CONFIG_HTTP_REDIRECT_CACHE
+
+/** @brief Looks up where hostname and path permanently moved to.
+ *
+ *  @param buf Set to the new hostname, followed by the new path after its
+ *  terminator, the layout send_http_request() keeps redirects in.
+ *  @param tls Set to whether the new location is https.
+ *  @return Whether a redirect that hasn't expired was found.
+ */
+bool redirect_cache_lookup(
+    const char *hostname, const char *path, char *buf, size_t size, bool *tls
+);
+
+/** @brief Remembers that hostname and path permanently moved, and saves it
+ *  to settings. URLs too long to keep are ignored. */
+void redirect_cache_store(
+    const char *hostname, const char *path, const char *new_hostname, const char *new_path,
+    bool tls
+);
+
+/** @brief Forgets where hostname and path moved to, for when requests to the
+ *  new location fail. */
+void redirect_cache_forget(const char *hostname, const char *path);
+
+#else
+
+static inline bool redirect_cache_lookup(
+    const char *hostname, const char *path, char *buf, size_t size, bool *tls
+) {
+  return false;
+}
+static inline void redirect_cache_store(
+    const char *hostname, const char *path, const char *new_hostname, const char *new_path,
+    bool tls
+) {}
+static inline void redirect_cache_forget(const char *hostname, const char *path) {}
+
+#endif  // CONFIG_HTTP_REDIRECT_CACHE
+
+#endif  // REDIRECT_CACHE_H
@@ -0,0 +1,338 @@
+#ifdef CONFIG_STOP_REQUEST_GTFS_RT
+
+#include "proto/gtfs_rt.h"
+
+#include <pb_decode.h>
+#include <src/proto/gtfs-realtime.pb.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include "json/stop_schema.h"
+#include "stop.h"
+#include "string_table.h"
+
+LOG_MODULE_REGISTER(gtfs_rt);
+
+/** FeedMessage field numbers */
+#define FEED_MESSAGE_HEADER 1
+#define FEED_MESSAGE_ENTITY 2
+
+/** Protobuf wire types */
+#define PB_WIRE_VARINT 0
+#define PB_WIRE_64BIT 1
+#define PB_WIRE_LEN 2
+#define PB_WIRE_32BIT 5
+
+enum gtfs_rt_state {
+  /** Reading the tag varint of the next FeedMessage field */
+  GTFS_RT_TAG = 0,
+  /** Reading the length of a length delimited field */
+  GTFS_RT_LENGTH,
+  /** Skipping a varint field */
+  GTFS_RT_VARINT,
+  /** Collecting, or skipping, pb_left bytes of field pb_field */
+  GTFS_RT_BYTES,
+};
+
+/** The stop_time_update for CONFIG_STOP_ID of the trip being decoded */
+struct stop_time_match {
+  unsigned int time_now;
+  bool found;
+  int64_t time;
+};
+
+static bool decode_stop_time_update(pb_istream_t *stream, const pb_field_t *field, void **arg) {
+  struct stop_time_match *match = *arg;
+  transit_realtime_TripUpdate_StopTimeUpdate update =
+      transit_realtime_TripUpdate_StopTimeUpdate_init_zero;
+
+  if (!pb_decode(stream, transit_realtime_TripUpdate_StopTimeUpdate_fields, &update)) {
+    return false;
+  }
+
+  if (match->found || !update.has_stop_id || (strcmp(update.stop_id, CONFIG_STOP_ID) != 0)) {
+    return true;
+  }
+
+  const transit_realtime_TripUpdate_StopTimeEvent *event =
+      update.has_departure ? &update.departure : (update.has_arrival ? &update.arrival : NULL);
+
+  /* A trip can pass the stop more than once, keep the first visit still to come */
+  if ((event != NULL) && event->has_time && (event->time > match->time_now)) {
+    match->time = event->time;
+    match->found = true;
+  }
+  return true;
+}
+
+static const GtfsRtRoute gtfs_rt_routes[] = GTFS_RT_ROUTES;
+
+/** Returns the route ID GTFS_RT_ROUTES gives route_id, or -1 if it isn't
+ *  listed. */
+static int route_display_id(const char *route_id) {
+  for (size_t i = 0; i < ARRAY_SIZE(gtfs_rt_routes); i++) {
+    if (strcmp(gtfs_rt_routes[i].route_id, route_id) == 0) {
+      return gtfs_rt_routes[i].id;
+    }
+  }
+  return -1;
+}
+
+/** Returns the route with id and direction_code. A new route is set up in the
+ *  first free slot, but only counted in routes_size once a departure of it
+ *  is accepted. */
+static RouteDirection *find_route(Stop *stop, int id, char direction_code) {
+  for (size_t i = 0; i < stop->routes_size; i++) {
+    RouteDirection *route_direction = &stop->route_directions[i];
+    if ((route_direction->id == id) && (route_direction->direction_code == direction_code)) {
+      return route_direction;
+    }
+  }
+
+  if (stop->routes_size == CONFIG_STOP_MAX_ROUTES) {
+    LOG_WRN("More than CONFIG_STOP_MAX_ROUTES (%d) routes, skipping.", CONFIG_STOP_MAX_ROUTES);
+    return NULL;
+  }
+
+  RouteDirection *route_direction = &stop->route_directions[stop->routes_size];
+
+  (void)memset(route_direction, 0, sizeof(*route_direction));
+  route_direction->id = id;
+  route_direction->direction_code = direction_code;
+  return route_direction;
+}
+
+/** Adds a departure to its route, through stop_departure_accept() like the
+ *  other feeds. Entities aren't sorted by time, so a departure earlier than
+ *  the one kept for its text takes its place. */
+static void add_departure(
+    StopParser *parser, const transit_realtime_TripDescriptor *trip, unsigned int etd
+) {
+  Stop *stop = parser->stop;
+  const int id = route_display_id(trip->route_id);
+  /* GTFS direction_id is 0 or 1, DISPLAY_BOXES use '0' and '1' for it */
+  const char direction_code = '0' + (trip->has_direction_id ? trip->direction_id : 0);
+  RouteDirection *route_direction;
+
+  if (id < 0) {
+    LOG_DBG("Route %s isn't in GTFS_RT_ROUTES, skipping.", trip->route_id);
+    return;
+  }
+
+  route_direction = find_route(stop, id, direction_code);
+  if (route_direction == NULL) {
+    return;
+  }
+
+  /* There is no headsign in a TripUpdate, the route_id is shown instead. It
+   * is the same for every trip of the route, so its next one is kept. */
+  const int text = string_table_intern(parser->ctx.texts, trip->route_id, strlen(trip->route_id));
+  const Departure departure = {.etd = etd, .text = (text < 0) ? STRING_ID_EMPTY : text};
+  const size_t index = route_direction - stop->route_directions;
+
+  for (size_t i = 0; i < route_direction->departures_size; i++) {
+    if (route_direction->departures[i].text == departure.text) {
+      route_direction->departures[i].etd = MIN(route_direction->departures[i].etd, etd);
+      return;
+    }
+  }
+
+  if (route_direction->departures_size == CONFIG_ROUTE_MAX_DEPARTURES) {
+    return;
+  }
+
+  /* Routes are counted from 1 in the schema context */
+  parser->ctx.route = index + 1;
+  if (!stop_departure_accept(
+          &departure, route_direction, route_direction->departures_size, &parser->ctx
+      )) {
+    return;
+  }
+
+  route_direction->departures[route_direction->departures_size++] = departure;
+  if (index == stop->routes_size) {
+    stop->routes_size++;
+  }
+}
+
+static void decode_entity(StopParser *parser) {
+  transit_realtime_FeedEntity entity = transit_realtime_FeedEntity_init_zero;
+  struct stop_time_match match = {.time_now = parser->ctx.time_now};
+  pb_istream_t stream =
+      pb_istream_from_buffer((const pb_byte_t *)parser->element, parser->element_len);
+
+  entity.trip_update.stop_time_update.funcs.decode = decode_stop_time_update;
+  entity.trip_update.stop_time_update.arg = &match;
+
+  if (!pb_decode(&stream, transit_realtime_FeedEntity_fields, &entity)) {
+    LOG_WRN("Failed to decode FeedEntity, skipping: %s", PB_GET_ERROR(&stream));
+    return;
+  }
+
+  if (entity.has_trip_update && match.found) {
+    add_departure(parser, &entity.trip_update.trip, (unsigned int)match.time);
+  }
+}
+
+static void decode_header(StopParser *parser) {
+  transit_realtime_FeedHeader header = transit_realtime_FeedHeader_init_zero;
+  pb_istream_t stream =
+      pb_istream_from_buffer((const pb_byte_t *)parser->element, parser->element_len);
+
+  if (!pb_decode(&stream, transit_realtime_FeedHeader_fields, &header)) {
+    LOG_WRN("Failed to decode FeedHeader: %s", PB_GET_ERROR(&stream));
+    return;
+  }
+
+  LOG_DBG("GTFS-realtime version: %s", header.gtfs_realtime_version);
+  if (header.has_timestamp) {
+    parser->stop->last_updated = header.timestamp * 1000;
+  }
+}
+
+/** Called once a whole FeedMessage field has been collected. */
+static void end_field(StopParser *parser) {
+  if (parser->element_overflow) {
+    LOG_WRN("FeedMessage field larger than %d bytes, skipping.", parser->element_size);
+  } else if (parser->pb_field == FEED_MESSAGE_ENTITY) {
+    decode_entity(parser);
+  } else if (parser->pb_field == FEED_MESSAGE_HEADER) {
+    decode_header(parser);
+  }
+}
+
+/** Handles a complete tag, length or skipped varint. */
+static void end_varint(StopParser *parser) {
+  const uint32_t value = parser->pb_varint;
+
+  parser->pb_varint = 0;
+  parser->pb_shift = 0;
+
+  switch (parser->pb_state) {
+    case GTFS_RT_TAG:
+      /* Only the length delimited header and entities are collected, other
+       * fields are skipped as field 0 */
+      parser->pb_field = ((value & 0x7) == PB_WIRE_LEN) ? (value >> 3) : 0;
+      parser->element_len = 0;
+      parser->element_overflow = false;
+      switch (value & 0x7) {
+        case PB_WIRE_VARINT:
+          parser->pb_state = GTFS_RT_VARINT;
+          break;
+        case PB_WIRE_64BIT:
+          parser->pb_left = 8;
+          parser->pb_state = GTFS_RT_BYTES;
+          break;
+        case PB_WIRE_LEN:
+          parser->pb_state = GTFS_RT_LENGTH;
+          break;
+        case PB_WIRE_32BIT:
+          parser->pb_left = 4;
+          parser->pb_state = GTFS_RT_BYTES;
+          break;
+        default:
+          LOG_ERR("Unsupported protobuf wire type %d", value & 0x7);
+          parser->err = 1;
+          break;
+      }
+      break;
+    case GTFS_RT_LENGTH:
+      parser->pb_left = value;
+      parser->pb_state = GTFS_RT_BYTES;
+      if (value == 0) {
+        end_field(parser);
+        parser->pb_state = GTFS_RT_TAG;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+int gtfs_rt_feed(const char *data, size_t len, void *user_data) {
+  StopParser *parser = user_data;
+  const uint32_t start = k_cycle_get_32();
+  size_t i = 0;
+
+  parser->bytes += len;
+
+  while ((i < len) && (parser->err == 0)) {
+    if (parser->pb_state == GTFS_RT_BYTES) {
+      const size_t run = MIN(parser->pb_left, len - i);
+      const bool collect = (parser->pb_field == FEED_MESSAGE_HEADER) ||
+                           (parser->pb_field == FEED_MESSAGE_ENTITY);
+
+      if (collect && !parser->element_overflow) {
+        if (run <= (parser->element_size - parser->element_len)) {
+          (void)memcpy(&parser->element[parser->element_len], &data[i], run);
+          parser->element_len += run;
+        } else {
+          parser->element_overflow = true;
+        }
+      }
+
+      i += run;
+      parser->pb_left -= run;
+      if (parser->pb_left == 0) {
+        if (collect) {
+          end_field(parser);
+        }
+        parser->pb_state = GTFS_RT_TAG;
+      }
+      continue;
+    }
+
+    const uint8_t c = data[i++];
+
+    if (parser->pb_state == GTFS_RT_VARINT) {
+      /* Skipped varints can be up to 64 bits, only their end matters */
+      if ((c & 0x80) == 0) {
+        parser->pb_state = GTFS_RT_TAG;
+      }
+      continue;
+    }
+
+    if (parser->pb_shift > 28) {
+      LOG_ERR("Protobuf varint longer than 32 bits");
+      parser->err = 1;
+      break;
+    }
+
+    parser->pb_varint |= (uint32_t)(c & 0x7F) << parser->pb_shift;
+    parser->pb_shift += 7;
+    if ((c & 0x80) == 0) {
+      end_varint(parser);
+    }
+  }
+
+  parser->cycles += k_cycle_get_32() - start;
+  return 0;
+}
+
+int gtfs_rt_finish(StopParser *parser) {
+  if (parser->err) {
+    LOG_ERR("Failed to decode GTFS-realtime feed");
+    return parser->err;
+  }
+
+  if ((parser->pb_state != GTFS_RT_TAG) || (parser->pb_shift != 0)) {
+    LOG_ERR("GTFS-realtime feed ended mid message");
+    return 3;
+  }
+
+  if (parser->bytes == 0) {
+    LOG_INF("No scheduled departures");
+    return 5;
+  }
+
+  if (parser->stop->routes_size == 0) {
+    LOG_WRN("No trips stopping at %s.", CONFIG_STOP_ID);
+  }
+
+  LOG_DBG("LastUpdated: %llu", parser->stop->last_updated);
+  return 0;
+}
+
+#endif  // CONFIG_STOP_REQUEST_GTFS_RT
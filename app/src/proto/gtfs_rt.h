@@ -0,0 +1,48 @@
+/** @file gtfs_rt.h
+ *  @brief Streaming GTFS-realtime TripUpdates decoder for the stop.
+ *
+ *  The FeedMessage is split into its FeedHeader and FeedEntity messages as
+ *  the body streams in. Each one is buffered on its own in the parser's
+ *  element buffer and decoded with nanopb, keeping only the stop_time_update
+ *  for CONFIG_STOP_ID, so the rest of the agency's feed is never held in
+ *  memory.
+ */
+
+#ifndef GTFS_RT_H
+#define GTFS_RT_H
+
+#include <stddef.h>
+
+#include "json/jsmn_parse.h"
+
+/** Specify the GTFS route_id of each route shown and the route ID DISPLAY_BOXES
+ *  use for it. route_id is a string, "B43" or "Red" as well as "10043". Trips
+ *  of routes not listed here are skipped. */
+// clang-format off
+#define GTFS_RT_ROUTES {                \
+  { .route_id = "30038", .id = 30038 }, \
+  { .route_id = "10043", .id = 10043 }, \
+  { .route_id = "10943", .id = 10943 }, \
+  { .route_id = "20029", .id = 20029 }  \
+}
+// clang-format on
+
+typedef const struct GtfsRtRoute {
+  const char *route_id;
+  const int id;
+} GtfsRtRoute;
+
+/** Feeds a chunk of the response body, matches http_body_cb_t.
+ *
+ *  @param user_data The StopParser, set up with stop_parser_init().
+ */
+int gtfs_rt_feed(const char *data, size_t len, void *user_data);
+
+/** Checks the feed ended on a message boundary.
+ *
+ *  @return 0 on success, 3 if the body was cut short, 5 if it was empty, or
+ *  1 on any other error, the same codes stop_parser_finish() uses.
+ */
+int gtfs_rt_finish(StopParser *parser);
+
+#endif  // GTFS_RT_H
@@ -1,9 +1,12 @@
 #ifndef STOP_H
 #define STOP_H
 
+#include "string_table.h"
+
 typedef struct Departure {
-  char display_text[50];
   unsigned int etd;
+  /** Display text, see Stop.texts */
+  string_id_t text;
 } Departure;
 
 typedef struct RouteDirection {
@@ -18,5 +21,7 @@ typedef struct Stop {
   const char *id;
   unsigned int routes_size;
   RouteDirection route_directions[CONFIG_STOP_MAX_ROUTES];
+  /** Display texts shared by all the departures */
+  StringTable texts;
 } Stop;
 #endif
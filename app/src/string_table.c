@@ -0,0 +1,61 @@
+/** @headerfile string_table.h */
+#include "string_table.h"
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(string_table);
+
+BUILD_ASSERT(CONFIG_STOP_MAX_TEXTS < UINT8_MAX, "string_id_t can't hold CONFIG_STOP_MAX_TEXTS");
+BUILD_ASSERT(CONFIG_STOP_TEXT_POOL_SIZE <= UINT16_MAX, "Pool offsets are 16 bit");
+
+/** 32 bit FNV-1a */
+static uint32_t string_hash(const char *str, size_t len) {
+  uint32_t hash = 2166136261u;
+
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ (uint8_t)str[i]) * 16777619u;
+  }
+  return hash;
+}
+
+void string_table_clear(StringTable *table) {
+  table->count = 0;
+  table->pool_len = 0;
+  (void)memset(table->buckets, 0, sizeof(table->buckets));
+  (void)string_table_intern(table, "", 0);
+}
+
+int string_table_intern(StringTable *table, const char *str, size_t len) {
+  len = MIN(len, STRING_TABLE_MAX_LEN - 1);
+
+  size_t bucket = string_hash(str, len) % STRING_TABLE_BUCKETS;
+
+  /* Linear probing, the table is never more than half full */
+  while (table->buckets[bucket] != 0) {
+    const string_id_t id = table->buckets[bucket] - 1;
+    const char *interned = string_table_get(table, id);
+
+    if ((strncmp(interned, str, len) == 0) && (interned[len] == '\0')) {
+      return id;
+    }
+    bucket = (bucket + 1) % STRING_TABLE_BUCKETS;
+  }
+
+  if ((table->count == CONFIG_STOP_MAX_TEXTS) ||
+      ((len + 1) > (sizeof(table->pool) - table->pool_len))) {
+    LOG_WRN("String table full, %d strings in %d bytes", table->count, table->pool_len);
+    return -1;
+  }
+
+  const string_id_t id = table->count++;
+
+  table->offsets[id] = table->pool_len;
+  (void)memcpy(&table->pool[table->pool_len], str, len);
+  table->pool[table->pool_len + len] = '\0';
+  table->pool_len += len + 1;
+  table->buckets[bucket] = id + 1;
+
+  return id;
+}
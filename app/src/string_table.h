@@ -0,0 +1,52 @@
+/** @file string_table.h
+ *  @brief Interned strings for the stop departures.
+ *
+ *  Each distinct string is copied into the pool once and referred to by a
+ *  small id, so departures don't each carry a fixed size text buffer. Lookups
+ *  hash the string into an open addressed bucket array, which keeps interning
+ *  O(1) no matter how many strings are stored.
+ */
+
+#ifndef STRING_TABLE_H
+#define STRING_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Longest string stored, including the NUL. Longer strings are truncated. */
+#define STRING_TABLE_MAX_LEN 50
+
+/** Twice the capacity so probe chains stay short */
+#define STRING_TABLE_BUCKETS (2 * CONFIG_STOP_MAX_TEXTS)
+
+typedef uint8_t string_id_t;
+
+/** The empty string, always interned first by string_table_clear() */
+#define STRING_ID_EMPTY 0
+
+typedef struct StringTable {
+  size_t count;
+  size_t pool_len;
+  /** Start of each string in pool, indexed by id. Includes the empty
+   *  string, so one less than CONFIG_STOP_MAX_TEXTS can be added. */
+  uint16_t offsets[CONFIG_STOP_MAX_TEXTS];
+  /** id + 1 of the string hashed to each bucket, 0 when empty */
+  string_id_t buckets[STRING_TABLE_BUCKETS];
+  char pool[CONFIG_STOP_TEXT_POOL_SIZE];
+} StringTable;
+
+/** @brief Removes all strings but the empty one. */
+void string_table_clear(StringTable *table);
+
+/** @brief Returns the id of the len bytes at str, adding them if needed.
+ *
+ *  @return The id, or -1 if the table or its pool is full.
+ */
+int string_table_intern(StringTable *table, const char *str, size_t len);
+
+/** @brief Returns the NUL terminated string for id. */
+static inline const char *string_table_get(const StringTable *table, string_id_t id) {
+  return &table->pool[table->offsets[id]];
+}
+
+#endif  // STRING_TABLE_H
@@ -3,19 +3,45 @@
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
+#include "arena.h"
+#ifdef CONFIG_STOP_REQUEST_JES_CBOR
+#include "cbor/stop_cbor.h"
+#endif  // CONFIG_STOP_REQUEST_JES_CBOR
+#ifdef CONFIG_STOP_REQUEST_GTFS_RT
+#include "proto/gtfs_rt.h"
+#endif  // CONFIG_STOP_REQUEST_GTFS_RT
 #include "display/display_switches.h"
 #include "display/led_display.h"
 #include "json/jsmn_parse.h"
 #include "net/custom_http_client.h"
+#include "net/http_stats.h"
+#ifdef CONFIG_HTTP_INFLATE
+#include "net/inflate.h"
+#endif  // CONFIG_HTTP_INFLATE
 #include "real_time_counter.h"
 #include "stop.h"
 
 LOG_MODULE_REGISTER(update_stop);
 
+/** Arena used by the client while it inflates a compressed response */
+#ifdef CONFIG_HTTP_INFLATE
+#define INFLATE_ARENA_SIZE (ROUND_UP(sizeof(Inflater), 8) + CONFIG_HTTP_INFLATE_WINDOW_SIZE)
+#else
+#define INFLATE_ARENA_SIZE 0
+#endif  // CONFIG_HTTP_INFLATE
+
+BUILD_ASSERT(
+    CONFIG_SCRATCH_ARENA_SIZE >
+        (CONFIG_STOP_RECV_BUF_SIZE + CONFIG_STOP_JSON_ROUTE_BUF_SIZE + INFLATE_ARENA_SIZE),
+    "CONFIG_SCRATCH_ARENA_SIZE must also leave room for a route's JSON tokens"
+);
+
 K_TIMER_DEFINE(update_stop_timer, update_stop_timeout_handler, NULL);
 
 K_SEM_DEFINE(update_stop_sem, 1, 1);
 
+struct k_poll_signal update_stop_signal = K_POLL_SIGNAL_INITIALIZER(update_stop_signal);
+
 static unsigned int minutes_to_departure(
     Departure* departure, unsigned int time_now
 ) {
@@ -37,7 +63,7 @@ static DisplayBox* get_display_address(
 }
 
 static int parse_returned_routes(
-    Stop stop, DisplayBox display_boxes[], unsigned int time_now
+    const Stop *stop, DisplayBox display_boxes[], unsigned int time_now
 ) {
   unsigned int min = 0;
 
@@ -47,8 +73,8 @@ static int parse_returned_routes(
     (void)display_off(box);
   }
 
-  for (size_t route_num = 0; route_num < stop.routes_size; route_num++) {
-    struct RouteDirection route_direction = stop.route_directions[route_num];
+  for (size_t route_num = 0; route_num < stop->routes_size; route_num++) {
+    const struct RouteDirection route_direction = stop->route_directions[route_num];
     LOG_INF(
         "\n========= Route ID: %d; Direction: %c; Departures size: %d "
         "========= ",
@@ -58,8 +84,12 @@ static int parse_returned_routes(
     for (size_t departure_num = 0;
          departure_num < route_direction.departures_size; departure_num++) {
       struct Departure departure = route_direction.departures[departure_num];
+      /* A Stop kept from an earlier response can hold departures that left */
+      if (departure.etd <= time_now) {
+        continue;
+      }
       min = minutes_to_departure(&departure, time_now);
-      LOG_INF("Display text: %s", departure.display_text);
+      LOG_INF("Display text: %s", string_table_get(&stop->texts, departure.text));
       LOG_INF("Minutes to departure: %d", min);
 
       DisplayBox* display = get_display_address(
@@ -95,6 +125,62 @@ static int parse_returned_routes(
   return 0;
 }
 
+/** Shows the departures, timed as the render phase of the refresh. */
+static int render_routes(const Stop* stop, DisplayBox display_boxes[], unsigned int time_now) {
+  const uint32_t start = k_cycle_get_32();
+  const int ret = parse_returned_routes(stop, display_boxes, time_now);
+
+  http_stats_since(HTTP_STATS_RENDER, start);
+  return ret;
+}
+
+#ifdef CONFIG_STOP_PARSER_STATS
+/** Logs how fast the last response was parsed and how close the parser came
+ *  to its token, arena and stack limits. */
+static void log_parser_stats(const StopParser* parser) {
+  const uint32_t us = MAX(k_cyc_to_us_floor32(parser->cycles), 1);
+  size_t stack_unused = 0;
+
+  (void)k_thread_stack_space_get(k_current_get(), &stack_unused);
+
+  LOG_INF(
+      "Stop JSON: %u bytes in %u us, %u KB/s", parser->bytes, us,
+      (uint32_t)(((uint64_t)parser->bytes * USEC_PER_SEC) / us / 1024)
+  );
+  LOG_INF(
+      "Tokens: %u/%u stop, %u for the largest route", parser->stop_tokens,
+      STOP_SCAFFOLD_TOK_COUNT, parser->max_route_tokens
+  );
+  LOG_INF(
+      "Scratch arena high-water: %u/%u, HTTP work queue stack high-water: %u/%u",
+      arena_high_water(), CONFIG_SCRATCH_ARENA_SIZE,
+      CONFIG_HTTP_WORK_QUEUE_STACK_SIZE - stack_unused, CONFIG_HTTP_WORK_QUEUE_STACK_SIZE
+  );
+}
+#endif  // CONFIG_STOP_PARSER_STATS
+
+#if defined(CONFIG_STOP_REQUEST_GTFS_RT)
+#define STOP_FEED gtfs_rt_feed
+#define STOP_FINISH gtfs_rt_finish
+#elif defined(CONFIG_STOP_REQUEST_JES_CBOR)
+#define STOP_FEED stop_cbor_feed
+#define STOP_FINISH stop_cbor_finish
+#else
+#define STOP_FEED stop_parser_feed
+#define STOP_FINISH stop_parser_finish
+#endif
+
+/** Clears the Stop once the first chunk of a new body arrives, so it is kept
+ *  as is when the server has nothing new to send. */
+static int stop_body_cb(const char* data, size_t len, void* user_data) {
+  StopParser* parser = user_data;
+
+  if (parser->bytes == 0) {
+    stop_parser_clear_stop(parser);
+  }
+  return STOP_FEED(data, len, user_data);
+}
+
 int update_stop(void) {
   int ret;
   unsigned int time_now;
@@ -102,33 +188,78 @@ int update_stop(void) {
   static const DisplayBox display_boxes[] = DISPLAY_BOXES;
 
   static char headers_buf[1024];
+  /** Validators of the response the Stop was parsed from */
+  static HttpCache cache;
 
   // Keep track of retry attempts so we don't get in a loop
   int retry_error = 0;
 
-  /** HTTP response body buffer with size defined by the
-   * CONFIG_STOP_JSON_BUF_SIZE
-   */
-  static char json_buf[CONFIG_STOP_JSON_BUF_SIZE];
+  static StopParser parser;
+
+  size_t mark;
+  char *recv_buf;
+  char *element_buf;
 
 retry:
+  /** Each recv() chunk of the response body is read into recv_buf and fed
+   * straight to the stop parser, so the whole body is never buffered. Both
+   * buffers, and the parser's JSON tokens, come from the scratch arena and
+   * are released before every return or retry.
+   */
+  mark = arena_mark();
+  recv_buf = arena_alloc(CONFIG_STOP_RECV_BUF_SIZE);
+  element_buf = arena_alloc(CONFIG_STOP_JSON_ROUTE_BUF_SIZE);
+  if ((recv_buf == NULL) || (element_buf == NULL)) {
+    LOG_ERR("No room in the scratch arena for the stop request buffers");
+    arena_release(mark);
+    return 1;
+  }
+
+  time_now = get_rtc_time();
+
+  stop_parser_init(&parser, &stop, time_now, element_buf, CONFIG_STOP_JSON_ROUTE_BUF_SIZE);
+
   ret = http_request_stop_json(
-      &json_buf[0], CONFIG_STOP_JSON_BUF_SIZE, headers_buf, sizeof(headers_buf)
+      recv_buf, CONFIG_STOP_RECV_BUF_SIZE, stop_body_cb, &parser, headers_buf,
+      sizeof(headers_buf), &cache
   );
-  if (ret) {
+  if (parser.bytes > 0) {
+    http_stats_add(HTTP_STATS_PARSE, k_cyc_to_us_floor32(parser.cycles));
+  }
+  if (ret == HTTP_CACHED) {
+    /* Nothing new, redisplay the Stop from the last response */
+    arena_release(mark);
+    if (stop.routes_size == 0) {
+      return 2;
+    }
+    return render_routes(&stop, display_boxes, time_now);
+  } else if (ret) {
     LOG_ERR("HTTP GET request for JSON failed; cleaning up. ERR: %d", ret);
-    return 1;
+    http_cache_clear(&cache);
+    arena_release(mark);
+    /* Keep showing what is left of the last response until a request gets
+     * through, the body callback only clears the Stop once a body arrives */
+    if ((parser.bytes == 0) && (stop.routes_size > 0)) {
+      (void)render_routes(&stop, display_boxes, time_now);
+    }
+    return 3;
   }
 
-  time_now = get_rtc_time();
+  if (parser.bytes == 0) {
+    stop_parser_clear_stop(&parser);
+  }
 
-  ret = parse_stop_json(&json_buf[0], &stop, time_now);
+  ret = STOP_FINISH(&parser);
+#ifdef CONFIG_STOP_PARSER_STATS
+  log_parser_stats(&parser);
+#endif  // CONFIG_STOP_PARSER_STATS
+  arena_release(mark);
   if (ret) {
-    LOG_DBG(
-        "recv_body_buf size: %d, recv_body strlen: %d",
-        CONFIG_STOP_JSON_BUF_SIZE, strlen(&json_buf[0])
-    );
-    LOG_DBG("recv_body_buf:\n%s", &json_buf[0]);
+    /* Unless the stop simply has no departures, the Stop doesn't match the
+     * response's validators and the next request must fetch the whole body */
+    if (ret != 5) {
+      http_cache_clear(&cache);
+    }
 
     /* A returned 3 corresponds to an incomplete JSON packet. Most likely this
      * means the HTTP transfer was incomplete. This may be a server-side issue,
@@ -137,6 +268,7 @@ retry:
     if (ret == 3 && retry_error == 0) {
       LOG_WRN("JSON download was incomplete, retrying...");
       retry_error = 1;
+      http_stats_retry();
       goto retry;
     } else if (ret == 5) {
       /* A returned 5 corresponds to a successful response with no scheduled
@@ -153,7 +285,7 @@ retry:
       stop.routes_size, stop.last_updated
   );
 
-  ret = parse_returned_routes(stop, display_boxes, time_now);
+  ret = render_routes(&stop, display_boxes, time_now);
   if (ret) {
     return 1;
   }
@@ -161,6 +293,21 @@ retry:
   return 0;
 }
 
+static void update_stop_work_handler(struct k_work* work) {
+  http_stats_begin();
+  const int ret = update_stop();
+  http_stats_end((ret != 0) && (ret != 2));
+
+  (void)k_poll_signal_raise(&update_stop_signal, ret);
+}
+
+K_WORK_DEFINE(update_stop_work, update_stop_work_handler);
+
+int update_stop_submit(void) {
+  k_poll_signal_reset(&update_stop_signal);
+  return http_submit(&update_stop_work);
+}
+
 void update_stop_timeout_handler(struct k_timer* timer_id) {
   (void)k_sem_give(&update_stop_sem);
 }
@@ -25,9 +25,22 @@ typedef const struct DisplayBox {
 } DisplayBox;
 
 void update_stop_timeout_handler(struct k_timer* timer_id);
+
+/** @brief Requests the stop's departures and shows them on the displays.
+ *
+ *  @return 0 on success, 1 on an error that needs a reset, 2 if there are no
+ *  departures to show, or 3 if the request failed or timed out and the
+ *  departures from the last response are shown instead.
+ */
 int update_stop(void);
 
+/** @brief Runs update_stop() on the HTTP work queue. update_stop_signal is
+ *  raised with its result once it is done.
+ */
+int update_stop_submit(void);
+
 extern struct k_timer update_stop_timer;
 extern struct k_sem update_stop_sem;
+extern struct k_poll_signal update_stop_signal;
 
 #endif
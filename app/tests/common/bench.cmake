@@ -0,0 +1,60 @@
+# Shared by the benchmarks, include()d after find_package(Zephyr)
+
+set(app_dir ${CMAKE_CURRENT_LIST_DIR}/../..)
+set(gen_dir ${ZEPHYR_BINARY_DIR}/include/generated)
+zephyr_include_directories(${gen_dir})
+
+# The same generated key classifier as the app
+add_custom_command(
+  OUTPUT ${gen_dir}/json_keys.h
+  COMMAND ${PYTHON_EXECUTABLE} ${app_dir}/scripts/gen_json_keys.py
+          ${app_dir}/src/json/json_keys.txt ${gen_dir}/json_keys.h
+  DEPENDS ${app_dir}/scripts/gen_json_keys.py ${app_dir}/src/json/json_keys.txt
+)
+add_custom_target(json_keys_h DEPENDS ${gen_dir}/json_keys.h)
+add_dependencies(app json_keys_h)
+
+target_include_directories(app PRIVATE ${app_dir}/src ${CMAKE_CURRENT_LIST_DIR}/src)
+target_sources(app PRIVATE ${CMAKE_CURRENT_LIST_DIR}/src/bench.c)
+
+# Code takes no simulated time on native_sim, so it is timed on the host clock
+if(CONFIG_ARCH_POSIX)
+  target_sources(native_simulator INTERFACE ${CMAKE_CURRENT_LIST_DIR}/src/host_clock.c)
+endif()
+
+# Builds every file of the test's corpus/ matching the globs into the app, with
+# a table of them in corpus.c, see src/corpus.h.
+function(add_corpus)
+  list(TRANSFORM ARGN PREPEND ${CMAKE_CURRENT_SOURCE_DIR}/corpus/ OUTPUT_VARIABLE corpus_globs)
+  file(GLOB corpus_files ${corpus_globs})
+  list(SORT corpus_files)
+  set(corpus_arrays "")
+  set(corpus_table "")
+  set(corpus_index 0)
+  foreach(corpus_file ${corpus_files})
+    get_filename_component(corpus_name ${corpus_file} NAME)
+    generate_inc_file_for_target(app ${corpus_file} ${gen_dir}/corpus/${corpus_name}.inc)
+    string(APPEND corpus_arrays
+      "static const char corpus_${corpus_index}[] = {\n#include \"corpus/${corpus_name}.inc\"\n};\n"
+    )
+    string(APPEND corpus_table
+      "    {\"${corpus_name}\", corpus_${corpus_index}, sizeof(corpus_${corpus_index})},\n"
+    )
+    math(EXPR corpus_index "${corpus_index} + 1")
+  endforeach()
+  file(CONFIGURE
+    OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/corpus.c
+    CONTENT "/* Generated from corpus/ by bench.cmake, do not edit. */
+#include \"corpus.h\"
+
+#include <zephyr/sys/util.h>
+
+${corpus_arrays}
+const CorpusFile corpus[] = {
+${corpus_table}};
+
+const size_t corpus_count = ARRAY_SIZE(corpus);
+"
+  )
+  target_sources(app PRIVATE ${CMAKE_CURRENT_BINARY_DIR}/corpus.c)
+endfunction()
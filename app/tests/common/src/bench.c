@@ -0,0 +1,45 @@
+/** @headerfile bench.h */
+#include "bench.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+/** Deeper than the stop parser goes, see CONFIG_ZTEST_STACK_SIZE */
+#define STACK_PROBE_SIZE 8192
+#define STACK_PAINT 0xA5
+
+/** Lowest address painted */
+static const volatile uint8_t *stack_probe;
+
+#ifdef CONFIG_ARCH_POSIX
+/* In the native simulator runner, see host_clock.c */
+uint64_t bench_host_time_ns(void);
+#endif  // CONFIG_ARCH_POSIX
+
+uint64_t bench_time_ns(void) {
+#ifdef CONFIG_ARCH_POSIX
+  return bench_host_time_ns();
+#else
+  return k_ticks_to_ns_floor64(k_uptime_ticks());
+#endif  // CONFIG_ARCH_POSIX
+}
+
+/* The probe array takes the place of the frames the caller makes next */
+__noinline void bench_stack_paint(void) {
+  volatile uint8_t probe[STACK_PROBE_SIZE];
+
+  for (size_t i = 0; i < sizeof(probe); i++) {
+    probe[i] = STACK_PAINT;
+  }
+  stack_probe = probe;
+}
+
+size_t bench_stack_used(void) {
+  size_t untouched = 0;
+
+  /* The stack grows down, the deepest frame left the lowest mark */
+  while ((untouched < STACK_PROBE_SIZE) && (stack_probe[untouched] == STACK_PAINT)) {
+    untouched++;
+  }
+  return STACK_PROBE_SIZE - untouched;
+}
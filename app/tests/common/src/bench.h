@@ -0,0 +1,25 @@
+/** @file bench.h
+ *  @brief Timing and stack measurements shared by the benchmarks.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Returns a monotonic time in ns, from the host clock on native_sim. */
+uint64_t bench_time_ns(void);
+
+/** @brief Fills the stack below the caller with a pattern.
+ *
+ *  Call bench_stack_used() from the same function to find how deep the code
+ *  called in between went.
+ */
+void bench_stack_paint(void);
+
+/** @brief Returns the bytes of the stack painted by bench_stack_paint() that
+ *  have since been written. */
+size_t bench_stack_used(void);
+
+#endif  // BENCH_H
@@ -0,0 +1,22 @@
+/** @file corpus.h
+ *  @brief Stop responses built in from a test's corpus/, see bench.cmake.
+ */
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stddef.h>
+
+/** Time the corpus departures are counted from, see each corpus/gen_corpus.py */
+#define CORPUS_TIME_NOW 1700000000
+
+typedef struct CorpusFile {
+  const char *name;
+  const char *data;
+  size_t size;
+} CorpusFile;
+
+extern const CorpusFile corpus[];
+extern const size_t corpus_count;
+
+#endif  // CORPUS_H
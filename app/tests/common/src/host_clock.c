@@ -0,0 +1,10 @@
+/* Built into the native simulator runner, against the host C library */
+#include <stdint.h>
+#include <time.h>
+
+uint64_t bench_host_time_ns(void) {
+  struct timespec ts;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000U) + (uint64_t)ts.tv_nsec;
+}
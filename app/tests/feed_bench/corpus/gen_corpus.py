@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Generates the synthetic JES stop responses in this directory.
+
+Each stop is written twice with the same content: as the JSON feed,
+NAME.json, and as the CBOR feed, NAME.cbor, see src/json/stop_schema.c and
+src/cbor/stop.cddl. They go from an empty stop up to more routes than
+CONFIG_STOP_MAX_ROUTES holds, and some departures have already left at
+CORPUS_TIME_NOW in tests/common/src/corpus.h so both decoders drop them.
+"""
+
+import json
+import os
+import random
+
+# Matches CORPUS_TIME_NOW in tests/common/src/corpus.h
+TIME_NOW = 1700000000
+
+STOP_ID = 73
+
+DESTINATIONS = [
+    "Amherst Ctr",
+    "UMass via Sunderland",
+    "Northampton",
+    "Hampshire Mall",
+    "Holyoke TC",
+    "Springfield Union Stn",
+    "Belchertown",
+    "South Deerfield",
+]
+
+
+def cbor_head(major, arg):
+    if arg < 24:
+        return bytes([major << 5 | arg])
+    for info, size in ((24, 1), (25, 2), (26, 4), (27, 8)):
+        if arg < 1 << (8 * size):
+            return bytes([major << 5 | info]) + arg.to_bytes(size, "big")
+    raise ValueError(arg)
+
+
+def cbor(value):
+    """Encodes the few types stop.cddl uses, without a CBOR package."""
+    if isinstance(value, int):
+        return cbor_head(0, value) if value >= 0 else cbor_head(1, -1 - value)
+    if isinstance(value, str):
+        data = value.encode("utf-8")
+        return cbor_head(3, len(data)) + data
+    if isinstance(value, list):
+        return cbor_head(4, len(value)) + b"".join(cbor(v) for v in value)
+    if isinstance(value, dict):
+        return cbor_head(5, len(value)) + b"".join(cbor(k) + cbor(v) for k, v in value.items())
+    raise TypeError(value)
+
+
+def route(rng, index, departures):
+    route_id = 30 + index
+    dests = rng.sample(DESTINATIONS, 2)
+    times = sorted(TIME_NOW + rng.randint(-120, 3600) for _ in range(departures))
+    return {
+        "id": route_id,
+        "dir": "NSEW"[index % 4],
+        "deps": [
+            {"text": "%d %s" % (route_id, dests[i % 2]), "etd": t} for i, t in enumerate(times)
+        ],
+    }
+
+
+def stop(seed, routes, departures):
+    rng = random.Random(seed)
+    return {
+        "updated": TIME_NOW * 1000,
+        "stop": STOP_ID,
+        "routes": [route(rng, i, rng.randint(1, departures)) for i in range(routes)],
+    }
+
+
+def stop_cbor(body):
+    """The same stop with the integer keys of stop.cddl."""
+    return {
+        0: body["updated"],
+        1: body["stop"],
+        2: [
+            {
+                0: r["id"],
+                1: r["dir"],
+                2: [{0: d["text"], 1: d["etd"]} for d in r["deps"]],
+            }
+            for r in body["routes"]
+        ],
+    }
+
+
+CORPUS = {
+    "jes_00_routes": stop(0, 0, 0),
+    "jes_01_route": stop(1, 1, 3),
+    "jes_04_routes": stop(4, 4, 5),
+    "jes_06_routes": stop(6, 6, 6),
+    "jes_12_routes": stop(12, 12, 6),
+}
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    for name, body in CORPUS.items():
+        with open(os.path.join(here, name + ".json"), "w", encoding="utf-8") as f:
+            f.write(json.dumps(body, separators=(",", ":")))
+        with open(os.path.join(here, name + ".cbor"), "wb") as f:
+            f.write(cbor(stop_cbor(body)))
+
+
+if __name__ == "__main__":
+    main()
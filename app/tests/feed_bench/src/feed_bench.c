@@ -0,0 +1,373 @@
+/* Fetches every stop of the corpus as the JES JSON feed and as the CBOR feed
+ * from a stand-in server on the loopback interface, checks both decode to the
+ * same Stop, and times each from request to decoded Stop. */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/ztest.h>
+
+#include "arena.h"
+#include "bench.h"
+#include "cbor/stop_cbor.h"
+#include "corpus.h"
+#include "json/jsmn_parse.h"
+#include "stop.h"
+
+#define SERVER_PORT 8080
+#define SERVER_STACK_SIZE 2048
+#define SERVER_PRIORITY K_PRIO_PREEMPT(1)
+
+/** Longest request line and headers either side sends */
+#define REQUEST_SIZE 256
+/** Longest corpus name with its extension, including the NUL */
+#define NAME_SIZE 64
+
+enum feed_format { FEED_JSON, FEED_CBOR, FEED_COUNT };
+
+/** How update_stop() requests and decodes a feed format */
+typedef struct FeedFormat {
+  const char *name;
+  /** Extension of the format's corpus files */
+  const char *extension;
+  /** Accept header sent by send_http_request() */
+  const char *accept;
+  int (*feed)(const char *data, size_t len, void *user_data);
+  int (*finish)(StopParser *parser);
+} FeedFormat;
+
+static const FeedFormat formats[FEED_COUNT] = {
+    [FEED_JSON] = {"JSON", ".json", "application/json", stop_parser_feed, stop_parser_finish},
+    [FEED_CBOR] = {"CBOR", ".cbor", "application/cbor", stop_cbor_feed, stop_cbor_finish},
+};
+
+static Stop stops[FEED_COUNT] = {
+    [FEED_JSON] = {.id = CONFIG_STOP_ID},
+    [FEED_CBOR] = {.id = CONFIG_STOP_ID},
+};
+static StopParser parser;
+
+K_THREAD_STACK_DEFINE(server_stack, SERVER_STACK_SIZE);
+static struct k_thread server_thread;
+static int server_sock = -1;
+
+static const CorpusFile *corpus_find(const char *name) {
+  for (size_t i = 0; i < corpus_count; i++) {
+    if (strcmp(corpus[i].name, name) == 0) {
+      return &corpus[i];
+    }
+  }
+  return NULL;
+}
+
+static int send_all(int sock, const char *data, size_t len) {
+  while (len > 0) {
+    const ssize_t sent = zsock_send(sock, data, len, 0);
+
+    if (sent < 0) {
+      return -errno;
+    }
+    data += sent;
+    len -= sent;
+  }
+  return 0;
+}
+
+/** Finds the corpus file a request is for, /NAME in the request line with the
+ *  extension of the format in its Accept header. */
+static const CorpusFile *server_find(const char *request) {
+  const FeedFormat *format = &formats[FEED_JSON];
+  const char *path;
+  size_t path_len;
+  char name[NAME_SIZE];
+
+  if (strncmp(request, "GET /", strlen("GET /")) != 0) {
+    return NULL;
+  }
+  path = request + strlen("GET /");
+  path_len = strcspn(path, " ");
+  if ((path_len + strlen(".json")) >= sizeof(name)) {
+    return NULL;
+  }
+  if (strstr(request, "Accept: application/cbor\r\n") != NULL) {
+    format = &formats[FEED_CBOR];
+  }
+
+  (void)memcpy(name, path, path_len);
+  (void)strcpy(&name[path_len], format->extension);
+  return corpus_find(name);
+}
+
+/** Stands in for the JES server, one request per connection like a server
+ *  answering Connection: close. */
+static void server_run(void *p1, void *p2, void *p3) {
+  char request[REQUEST_SIZE];
+  char headers[REQUEST_SIZE];
+
+  while (true) {
+    const int sock = zsock_accept(server_sock, NULL, NULL);
+    const CorpusFile *file = NULL;
+    size_t len = 0;
+    int headers_len;
+
+    if (sock < 0) {
+      return;
+    }
+
+    request[0] = '\0';
+    while (strstr(request, "\r\n\r\n") == NULL) {
+      const ssize_t bytes = zsock_recv(sock, &request[len], sizeof(request) - 1 - len, 0);
+
+      if (bytes <= 0) {
+        break;
+      }
+      len += bytes;
+      request[len] = '\0';
+    }
+
+    file = server_find(request);
+    if (file == NULL) {
+      headers_len = snprintf(
+          headers, sizeof(headers),
+          "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+      );
+      (void)send_all(sock, headers, headers_len);
+    } else {
+      headers_len = snprintf(
+          headers, sizeof(headers),
+          "HTTP/1.1 200 OK\r\nContent-Type: application/%s\r\nContent-Length: %zu\r\n"
+          "Connection: close\r\n\r\n",
+          strrchr(file->name, '.') + 1, file->size
+      );
+      if (send_all(sock, headers, headers_len) == 0) {
+        (void)send_all(sock, file->data, file->size);
+      }
+    }
+    (void)zsock_close(sock);
+  }
+}
+
+/** Requests a stop the way send_http_request() does and feeds the response
+ *  body to the format's decoder as it is received.
+ *
+ *  @param wire_bytes Set to the bytes of the response, headers included.
+ *
+ *  @return 0 once the server closed the connection, or a negative errno.
+ */
+static int fetch(
+    const char *stop_name, const FeedFormat *format, char *recv_buf, size_t *wire_bytes
+) {
+  struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(SERVER_PORT)};
+  char request[REQUEST_SIZE];
+  /* Characters of the "\r\n\r\n" ending the headers seen so far */
+  int headers_end = 0;
+  ssize_t bytes;
+  int request_len;
+  int sock;
+  int err = 0;
+
+  *wire_bytes = 0;
+  (void)zsock_inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  sock = zsock_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sock < 0) {
+    return -errno;
+  }
+  if (zsock_connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    err = -errno;
+    goto clean_up;
+  }
+
+  request_len = snprintf(
+      request, sizeof(request),
+      "GET /%s HTTP/1.1\r\nHost: 127.0.0.1:%d\r\nUser-Agent: EDB/bench Stop-ID/" CONFIG_STOP_ID
+      "\r\nAccept: %s\r\nConnection: close\r\n\r\n",
+      stop_name, SERVER_PORT, format->accept
+  );
+  err = send_all(sock, request, request_len);
+  if (err) {
+    goto clean_up;
+  }
+
+  while ((bytes = zsock_recv(sock, recv_buf, CONFIG_STOP_RECV_BUF_SIZE, 0)) > 0) {
+    ssize_t body = 0;
+
+    *wire_bytes += bytes;
+    while ((headers_end < 4) && (body < bytes)) {
+      if (recv_buf[body] == "\r\n\r\n"[headers_end]) {
+        headers_end++;
+      } else {
+        headers_end = (recv_buf[body] == '\r') ? 1 : 0;
+      }
+      body++;
+    }
+    if (body < bytes) {
+      (void)format->feed(&recv_buf[body], bytes - body, &parser);
+    }
+  }
+  if (bytes < 0) {
+    err = -errno;
+  }
+
+clean_up:
+  (void)zsock_close(sock);
+  return err;
+}
+
+/** Fetches a stop into stops[format] with update_stop()'s buffers taken from
+ *  the scratch arena, and optionally only decodes the already received body.
+ *
+ *  @param body The body to decode without fetching it, or NULL to fetch it.
+ *
+ *  @return What the format's finish returned, or a negative errno if the
+ *  buffers didn't fit in the arena or the request failed.
+ */
+static int load_stop(
+    const char *stop_name, enum feed_format format, const CorpusFile *body, size_t *wire_bytes
+) {
+  const size_t mark = arena_mark();
+  char *recv_buf = arena_alloc(CONFIG_STOP_RECV_BUF_SIZE);
+  char *element_buf = arena_alloc(CONFIG_STOP_JSON_ROUTE_BUF_SIZE);
+  int ret;
+
+  if ((recv_buf == NULL) || (element_buf == NULL)) {
+    arena_release(mark);
+    return -ENOMEM;
+  }
+
+  stop_parser_init(
+      &parser, &stops[format], CORPUS_TIME_NOW, element_buf, CONFIG_STOP_JSON_ROUTE_BUF_SIZE
+  );
+  stop_parser_clear_stop(&parser);
+  if (body == NULL) {
+    ret = fetch(stop_name, &formats[format], recv_buf, wire_bytes);
+  } else {
+    for (size_t offset = 0; offset < body->size; offset += CONFIG_STOP_RECV_BUF_SIZE) {
+      (void)formats[format].feed(
+          &body->data[offset], MIN(body->size - offset, CONFIG_STOP_RECV_BUF_SIZE), &parser
+      );
+    }
+    ret = 0;
+  }
+  if (ret == 0) {
+    ret = formats[format].finish(&parser);
+  }
+
+  arena_release(mark);
+  return ret;
+}
+
+static void assert_stops_equal(const char *stop_name) {
+  const Stop *json = &stops[FEED_JSON];
+  const Stop *cbor = &stops[FEED_CBOR];
+
+  zassert_equal(json->last_updated, cbor->last_updated, "%s updated differs", stop_name);
+  zassert_equal(json->routes_size, cbor->routes_size, "%s routes differ", stop_name);
+  for (unsigned int i = 0; i < json->routes_size; i++) {
+    const RouteDirection *json_route = &json->route_directions[i];
+    const RouteDirection *cbor_route = &cbor->route_directions[i];
+
+    zassert_equal(json_route->id, cbor_route->id, "%s route %u differs", stop_name, i);
+    zassert_equal(json_route->direction_code, cbor_route->direction_code);
+    zassert_equal(json_route->departures_size, cbor_route->departures_size);
+    for (unsigned int j = 0; j < json_route->departures_size; j++) {
+      const Departure *json_departure = &json_route->departures[j];
+      const Departure *cbor_departure = &cbor_route->departures[j];
+
+      zassert_equal(json_departure->etd, cbor_departure->etd);
+      zassert_str_equal(
+          string_table_get(&json->texts, json_departure->text),
+          string_table_get(&cbor->texts, cbor_departure->text)
+      );
+    }
+  }
+}
+
+ZTEST(feed_bench, test_json_vs_cbor) {
+  size_t total_bytes[FEED_COUNT] = {0};
+
+  TC_PRINT(
+      "%-16s %6s %7s %7s %6s %14s %10s\n", "stop", "format", "body", "wire", "routes",
+      "ns/fetch+dec", "ns/decode"
+  );
+
+  for (size_t i = 0; i < corpus_count; i++) {
+    const char *extension = strrchr(corpus[i].name, '.');
+    char stop_name[NAME_SIZE];
+
+    /* Each stop once, by its JSON file */
+    if ((extension == NULL) || (strcmp(extension, formats[FEED_JSON].extension) != 0)) {
+      continue;
+    }
+    (void)snprintf(
+        stop_name, sizeof(stop_name), "%.*s", (int)(extension - corpus[i].name), corpus[i].name
+    );
+
+    for (int format = 0; format < FEED_COUNT; format++) {
+      char file_name[NAME_SIZE];
+      size_t wire_bytes;
+
+      (void)snprintf(file_name, sizeof(file_name), "%s%s", stop_name, formats[format].extension);
+      const CorpusFile *body = corpus_find(file_name);
+
+      zassert_not_null(body, "No %s for %s", formats[format].name, stop_name);
+
+      const int ret = load_stop(stop_name, format, NULL, &wire_bytes);
+
+      /* 5 is a stop without departures */
+      zassert_true((ret == 0) || (ret == 5), "%s failed: %d", file_name, ret);
+
+      uint64_t start = bench_time_ns();
+      for (int n = 0; n < CONFIG_FEED_BENCH_ITERATIONS; n++) {
+        (void)load_stop(stop_name, format, NULL, &wire_bytes);
+      }
+      const uint64_t fetch_ns = (bench_time_ns() - start) / CONFIG_FEED_BENCH_ITERATIONS;
+
+      start = bench_time_ns();
+      for (int n = 0; n < CONFIG_FEED_BENCH_ITERATIONS; n++) {
+        (void)load_stop(stop_name, format, body, NULL);
+      }
+      const uint64_t decode_ns = (bench_time_ns() - start) / CONFIG_FEED_BENCH_ITERATIONS;
+
+      total_bytes[format] += wire_bytes;
+      TC_PRINT(
+          "%-16s %6s %7zu %7zu %6u %14llu %10llu\n", stop_name, formats[format].name, body->size,
+          wire_bytes, stops[format].routes_size, fetch_ns, decode_ns
+      );
+    }
+
+    assert_stops_equal(stop_name);
+  }
+
+  TC_PRINT(
+      "Response bytes, JSON: %zu, CBOR: %zu (%zu%%)\n", total_bytes[FEED_JSON],
+      total_bytes[FEED_CBOR], (100 * total_bytes[FEED_CBOR]) / total_bytes[FEED_JSON]
+  );
+}
+
+static void *server_setup(void) {
+  struct sockaddr_in addr = {
+      .sin_family = AF_INET, .sin_port = htons(SERVER_PORT), .sin_addr = INADDR_ANY_INIT
+  };
+  const int reuse = 1;
+
+  server_sock = zsock_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  zassert_true(server_sock >= 0, "socket() failed: %d", errno);
+  (void)zsock_setsockopt(server_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  zassert_ok(zsock_bind(server_sock, (struct sockaddr *)&addr, sizeof(addr)));
+  zassert_ok(zsock_listen(server_sock, 1));
+
+  (void)k_thread_create(
+      &server_thread, server_stack, K_THREAD_STACK_SIZEOF(server_stack), server_run, NULL, NULL,
+      NULL, SERVER_PRIORITY, 0, K_NO_WAIT
+  );
+  return NULL;
+}
+
+static void server_teardown(void *fixture) {
+  k_thread_abort(&server_thread);
+  (void)zsock_close(server_sock);
+}
+
+ZTEST_SUITE(feed_bench, NULL, server_setup, NULL, NULL, server_teardown);
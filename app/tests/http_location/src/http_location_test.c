@@ -0,0 +1,146 @@
+/* Checks redirects are resolved into the hostname and path layout
+ * send_http_request() keeps them in, and that locations too long for the
+ * buffer are rejected without writing past it. */
+#include <string.h>
+#include <zephyr/ztest.h>
+
+#include "net/http_location.h"
+
+/** As large as send_http_request()'s redirect_hostname_buf */
+#define REDIRECT_BUF_SIZE 255
+#define CANARY 0xa5
+
+/** A redirect buffer with bytes after it that must stay untouched */
+static struct {
+  char buf[REDIRECT_BUF_SIZE];
+  unsigned char canary[32];
+} redirect;
+
+static char location[2 * REDIRECT_BUF_SIZE];
+
+static void redirect_reset(void *fixture) {
+  ARG_UNUSED(fixture);
+  (void)memset(&redirect, 0, sizeof(redirect));
+  (void)memset(redirect.canary, CANARY, sizeof(redirect.canary));
+}
+
+static void check_canary(void) {
+  for (size_t i = 0; i < sizeof(redirect.canary); i++) {
+    zassert_equal(redirect.canary[i], CANARY, "Wrote past the buffer at +%zu", i);
+  }
+}
+
+/** Fills location with prefix followed by a path of path_len bytes */
+static void long_location(const char *prefix, size_t path_len) {
+  char *ptr = stpcpy(location, prefix);
+
+  zassert_true((ptr - location) + path_len < sizeof(location));
+  *ptr++ = '/';
+  (void)memset(ptr, 'p', path_len - 1);
+  ptr[path_len - 1] = '\0';
+}
+
+ZTEST(http_location, test_relative) {
+  char *path;
+  bool tls = true;
+  char *hostname;
+
+  (void)strcpy(location, "/stops/73");
+  hostname = http_location_resolve(
+      location, "bustracker.example", redirect.buf, sizeof(redirect.buf), &path, &tls
+  );
+  zassert_equal_ptr(hostname, redirect.buf);
+  zassert_str_equal(hostname, "bustracker.example");
+  zassert_str_equal(path, "/stops/73");
+  zassert_equal_ptr(path, &redirect.buf[strlen(hostname) + 1]);
+  zassert_true(tls, "A relative location changed the scheme");
+
+  /* A second redirect, from the host the first one left in the buffer */
+  (void)strcpy(location, "/v2/stops/73");
+  hostname = http_location_resolve(
+      location, hostname, redirect.buf, sizeof(redirect.buf), &path, &tls
+  );
+  zassert_str_equal(hostname, "bustracker.example");
+  zassert_str_equal(path, "/v2/stops/73");
+  check_canary();
+}
+
+ZTEST(http_location, test_absolute) {
+  char *path;
+  bool tls = true;
+  char *hostname;
+
+  (void)strcpy(location, "http://other.example/departures?stop=73");
+  hostname = http_location_resolve(
+      location, "bustracker.example", redirect.buf, sizeof(redirect.buf), &path, &tls
+  );
+  zassert_str_equal(hostname, "other.example");
+  zassert_str_equal(path, "/departures?stop=73");
+  zassert_equal_ptr(path, &redirect.buf[strlen(hostname) + 1]);
+  zassert_false(tls);
+
+  (void)strcpy(location, "https://secure.example/");
+  hostname = http_location_resolve(
+      location, hostname, redirect.buf, sizeof(redirect.buf), &path, &tls
+  );
+  zassert_str_equal(hostname, "secure.example");
+  zassert_str_equal(path, "/");
+  zassert_true(tls);
+  check_canary();
+}
+
+ZTEST(http_location, test_malformed) {
+  char *path;
+  bool tls = false;
+
+  (void)strcpy(location, "ftp://other.example/stops");
+  zassert_is_null(http_location_resolve(
+      location, "bustracker.example", redirect.buf, sizeof(redirect.buf), &path, &tls
+  ));
+  (void)strcpy(location, "https://other.example");
+  zassert_is_null(http_location_resolve(
+      location, "bustracker.example", redirect.buf, sizeof(redirect.buf), &path, &tls
+  ));
+  (void)strcpy(location, "h");
+  zassert_is_null(http_location_resolve(
+      location, "bustracker.example", redirect.buf, sizeof(redirect.buf), &path, &tls
+  ));
+  check_canary();
+}
+
+ZTEST(http_location, test_too_long) {
+  char *path;
+  bool tls = false;
+  const char *host = "a.example";
+
+  /* A short host with a path that just fits, then one byte too many */
+  long_location("http://a.example", REDIRECT_BUF_SIZE - strlen(host) - 2);
+  zassert_not_null(http_location_resolve(
+      location, "bustracker.example", redirect.buf, sizeof(redirect.buf), &path, &tls
+  ));
+  zassert_equal(strlen(path), REDIRECT_BUF_SIZE - strlen(host) - 2);
+  check_canary();
+
+  long_location("http://a.example", REDIRECT_BUF_SIZE - strlen(host) - 1);
+  zassert_is_null(http_location_resolve(
+      location, "bustracker.example", redirect.buf, sizeof(redirect.buf), &path, &tls
+  ));
+  long_location("https://a.example", 4 * REDIRECT_BUF_SIZE / 3);
+  zassert_is_null(http_location_resolve(
+      location, "bustracker.example", redirect.buf, sizeof(redirect.buf), &path, &tls
+  ));
+  check_canary();
+
+  /* The same for a relative location, which keeps the longer host */
+  long_location("", REDIRECT_BUF_SIZE - strlen("bustracker.example") - 2);
+  zassert_not_null(http_location_resolve(
+      location, "bustracker.example", redirect.buf, sizeof(redirect.buf), &path, &tls
+  ));
+  long_location("", REDIRECT_BUF_SIZE - strlen("bustracker.example") - 1);
+  zassert_is_null(http_location_resolve(
+      location, "bustracker.example", redirect.buf, sizeof(redirect.buf), &path, &tls
+  ));
+  check_canary();
+}
+
+ZTEST_SUITE(http_location, NULL, NULL, redirect_reset, NULL, NULL);
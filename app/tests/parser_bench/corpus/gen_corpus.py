@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""Generates the synthetic BusTracker responses in this directory.
+
+The responses follow the layout of InfoPoint SignageStopDepartures bodies,
+including the members the stop parser ignores: the *LocalTime twins of every
+date, the nested Trip object of each departure and the HeadwayDepartures of
+headway routes. They go from an empty stop up to more routes than
+CONFIG_STOP_MAX_ROUTES holds.
+
+Every date is after CORPUS_TIME_NOW in tests/common/src/corpus.h, so no
+departure is dropped as already gone. Responses captured from a real server can
+be saved next to these as they are, any *.json file here is built into the
+benchmark.
+"""
+
+import json
+import os
+import random
+
+# Matches CORPUS_TIME_NOW in tests/common/src/corpus.h
+TIME_NOW = 1700000000
+
+DESTINATIONS = [
+    "Amherst Ctr",
+    "UMass via Sunderland",
+    "Northampton",
+    "Hampshire Mall",
+    "Holyoke TC",
+    "Springfield Union Stn",
+    "Belchertown",
+    "South Deerfield",
+]
+
+
+def date(s):
+    return "/Date(%d-0500)/" % (s * 1000)
+
+
+def local(s):
+    return "2023-11-14T%02d:%02d:%02d" % ((s // 3600) % 24, (s // 60) % 60, s % 60)
+
+
+def trip(rng, route_id, direction, dest, start):
+    return {
+        "BlockFareboxId": rng.randint(100, 999),
+        "GtfsTripId": "t%d" % rng.randint(100000, 999999),
+        "InternalSignDesc": dest,
+        "InternetServiceDesc": dest,
+        "IVRServiceDesc": dest,
+        "StopSequence": rng.randint(1, 60),
+        "TripDirection": direction,
+        "TripId": rng.randint(100000, 999999),
+        "TripRecordId": rng.randint(1000000, 9999999),
+        "TripStartTime": date(start),
+        "TripStartTimeLocalTime": local(start),
+        "TripStatus": 0,
+        "TripStatusReportLabel": "Scheduled",
+    }
+
+
+def departure(rng, route_id, direction, dest, when):
+    dev = rng.randint(-120, 300)
+    return {
+        "ADT": None,
+        "ADTLocalTime": None,
+        "ATA": None,
+        "ATALocalTime": None,
+        "Bay": None,
+        "Dev": "00:%02d:%02d" % (abs(dev) // 60, abs(dev) % 60),
+        "DisplayText": "%d %s" % (route_id, dest),
+        "EDT": date(when + dev),
+        "EDTLocalTime": local(when + dev),
+        "ETA": date(when + dev),
+        "ETALocalTime": local(when + dev),
+        "GoogleTripId": "t%d" % rng.randint(100000, 999999),
+        "IsCompleted": False,
+        "IsLastStopOnTrip": False,
+        "LastUpdated": date(TIME_NOW),
+        "LastUpdatedLocalTime": local(TIME_NOW),
+        "Mode": 0,
+        "ModeReportLabel": "Normal",
+        "PropogationStatus": 0,
+        "SDT": date(when),
+        "SDTLocalTime": local(when),
+        "STA": date(when),
+        "STALocalTime": local(when),
+        "StopFlag": 0,
+        "StopStatus": 0,
+        "StopStatusReportLabel": "Scheduled",
+        "Trip": trip(rng, route_id, direction, dest, when - 1200),
+        "VehicleId": rng.randint(3000, 3999),
+    }
+
+
+def headway(rng, route_id, direction, dest, when):
+    return {
+        "HeadwayIntervalScheduled": 600,
+        "HeadwayIntervalTarget": 600,
+        "HeadwayName": "%d %s" % (route_id, dest),
+        "LastUpdated": date(TIME_NOW),
+        "LastUpdatedLocalTime": local(TIME_NOW),
+        "NextDeparture": date(when),
+        "NextDepartureLocalTime": local(when),
+        "Trip": trip(rng, route_id, direction, dest, when - 1200),
+    }
+
+
+def route(rng, index, departures, is_headway):
+    route_id = 30 + index
+    direction = "NSEW"[index % 4]
+    dests = rng.sample(DESTINATIONS, 2)
+    times = sorted(TIME_NOW + rng.randint(180, 3600) for _ in range(departures))
+    deps = [departure(rng, route_id, direction, dests[i % 2], t) for i, t in enumerate(times)]
+    return {
+        "Departures": [] if is_headway else deps,
+        "Direction": direction,
+        "HeadwayDepartures": (
+            [headway(rng, route_id, direction, dests[0], t) for t in times] if is_headway else None
+        ),
+        "IsDone": False,
+        "IsHeadway": is_headway,
+        "IsHeadwayMonitored": is_headway,
+        "RouteId": route_id,
+        "RouteRecordId": 1000 + route_id,
+    }
+
+
+def stop(seed, routes, departures, headway_every=0):
+    rng = random.Random(seed)
+    return [
+        {
+            "LastUpdated": date(TIME_NOW),
+            "RouteDirections": [
+                route(
+                    rng,
+                    i,
+                    rng.randint(1, departures),
+                    (headway_every > 0) and (i % headway_every == headway_every - 1),
+                )
+                for i in range(routes)
+            ],
+            "StopId": 73,
+            "StopRecordId": 1073,
+        }
+    ]
+
+
+CORPUS = {
+    "bustracker_00_routes.json": stop(0, 0, 0),
+    "bustracker_01_route.json": stop(1, 1, 3),
+    "bustracker_04_routes.json": stop(4, 4, 4),
+    "bustracker_06_routes_headway.json": stop(6, 6, 4, headway_every=3),
+    "bustracker_12_routes_headway.json": stop(12, 12, 4, headway_every=2),
+}
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    for name, body in CORPUS.items():
+        text = json.dumps(body, separators=(",", ":")).replace("/", "\\/")
+        with open(os.path.join(here, name), "w", encoding="utf-8") as f:
+            f.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,300 @@
+/* Times the stop parser over the corpus, as update_stop() drives it, and checks
+ * every response fits the parser's token, arena and stack limits and is
+ * rejected when another stop was requested. Also times jsmn alone over each
+ * response, where CONFIG_JSON_SWAR_SCAN matters most, and the key classifier
+ * against the jsoneq() chains it replaced. */
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/ztest.h>
+
+#define JSMN_HEADER
+
+#include "arena.h"
+#include "bench.h"
+#include "corpus.h"
+#include "json/jsmn.h"
+#include "json/jsmn_parse.h"
+#include "json/json_helpers.h"
+#include "stop.h"
+
+static Stop stop = {.id = CONFIG_STOP_ID};
+static StopParser parser;
+
+/** Tokens of the responses the keys are timed in, the largest in the corpus
+ *  has 2144 */
+#define KEY_BENCH_TOKENS 2560
+/** Deepest key of a BusTracker response, in a departure's Trip */
+#define KEY_BENCH_MAX_DEPTH 16
+
+/** The jsoneq() chains the Stop, RouteDirection and Departure loops ran before
+ *  json_key_classify(), indexed by the depth of their keys in a response */
+static const char *const stop_keys[] = {"LastUpdated", "RouteDirections", "StopId", NULL};
+static const char *const route_keys[] = {"Direction", "IsDone",     "IsHeadway",
+                                         "RouteId",   "Departures", "HeadwayDepartures",
+                                         NULL};
+static const char *const departure_keys[] = {"DisplayText", "EDT", "ETA", "GoogleTripId",
+                                             "LastUpdated", "SDT", "STA", "VehicleId",
+                                             NULL};
+static const char *const *const key_chains[KEY_BENCH_MAX_DEPTH] = {
+    [2] = stop_keys, [4] = route_keys, [6] = departure_keys
+};
+
+static jsmntok_t key_bench_tokens[KEY_BENCH_TOKENS];
+/** Index in key_bench_tokens and chain of each key timed */
+static uint16_t bench_keys[KEY_BENCH_TOKENS];
+static const char *const *bench_key_chains[KEY_BENCH_TOKENS];
+
+/** Arena left for a route's tokens once update_stop() took its buffers */
+#define ROUTE_TOKENS_ARENA_SIZE                                                           \
+  (CONFIG_SCRATCH_ARENA_SIZE - ROUND_UP(CONFIG_STOP_RECV_BUF_SIZE, 8) -                    \
+   ROUND_UP(CONFIG_STOP_JSON_ROUTE_BUF_SIZE, 8))
+
+/** Parses a response the way update_stop() does, with its buffers taken from
+ *  the scratch arena and the body fed in recv() sized chunks.
+ *
+ *  @return What stop_parser_finish() returned, or -ENOMEM if the buffers
+ *  didn't fit in the arena.
+ */
+static int parse_response(const CorpusFile *file) {
+  const size_t mark = arena_mark();
+  /* Only taken for the arena to be laid out as on the board, the chunks are
+   * fed straight from the corpus */
+  char *recv_buf = arena_alloc(CONFIG_STOP_RECV_BUF_SIZE);
+  char *element_buf = arena_alloc(CONFIG_STOP_JSON_ROUTE_BUF_SIZE);
+  int ret;
+
+  if ((recv_buf == NULL) || (element_buf == NULL)) {
+    arena_release(mark);
+    return -ENOMEM;
+  }
+
+  stop_parser_init(&parser, &stop, CORPUS_TIME_NOW, element_buf, CONFIG_STOP_JSON_ROUTE_BUF_SIZE);
+  stop_parser_clear_stop(&parser);
+  for (size_t offset = 0; offset < file->size; offset += CONFIG_STOP_RECV_BUF_SIZE) {
+    (void)stop_parser_feed(
+        &file->data[offset], MIN(file->size - offset, CONFIG_STOP_RECV_BUF_SIZE), &parser
+    );
+  }
+  ret = stop_parser_finish(&parser);
+
+  arena_release(mark);
+  return ret;
+}
+
+ZTEST(parser_bench, test_corpus) {
+  TC_PRINT(
+      "%-34s %7s %6s %10s %9s %11s %16s %6s\n", "response", "bytes", "routes", "ns/parse",
+      "KB/s", "stop tokens", "route tokens", "stack"
+  );
+
+  for (size_t i = 0; i < corpus_count; i++) {
+    const CorpusFile *file = &corpus[i];
+
+    bench_stack_paint();
+    const int ret = parse_response(file);
+    const size_t stack_used = bench_stack_used();
+
+    /* 5 is a stop without departures */
+    zassert_true((ret == 0) || (ret == 5), "%s failed to parse: %d", file->name, ret);
+    zassert_true(parser.stop_tokens <= STOP_SCAFFOLD_TOK_COUNT);
+    zassert_true(
+        (parser.max_route_tokens * sizeof(jsmntok_t)) <= ROUTE_TOKENS_ARENA_SIZE,
+        "%s has a route with more tokens than fit in the arena", file->name
+    );
+
+    const uint64_t start = bench_time_ns();
+    for (int n = 0; n < CONFIG_PARSER_BENCH_ITERATIONS; n++) {
+      (void)parse_response(file);
+    }
+    const uint64_t ns = MAX((bench_time_ns() - start) / CONFIG_PARSER_BENCH_ITERATIONS, 1);
+
+    TC_PRINT(
+        "%-34s %7zu %6u %10llu %9llu %5u/%-5u %7u/%-8zu %6zu\n", file->name, file->size,
+        stop.routes_size, ns, ((uint64_t)file->size * NSEC_PER_SEC) / ns / 1024,
+        parser.stop_tokens, STOP_SCAFFOLD_TOK_COUNT, parser.max_route_tokens,
+        ROUTE_TOKENS_ARENA_SIZE / sizeof(jsmntok_t), stack_used
+    );
+  }
+
+  TC_PRINT(
+      "Scratch arena high-water: %zu/%u bytes\n", arena_high_water(), CONFIG_SCRATCH_ARENA_SIZE
+  );
+}
+
+ZTEST(parser_bench, test_other_stop) {
+  for (size_t i = 0; i < corpus_count; i++) {
+    stop.id = "74";
+    const int ret = parse_response(&corpus[i]);
+    stop.id = CONFIG_STOP_ID;
+
+    zassert_equal(ret, 1, "%s parsed as another stop's feed: %d", corpus[i].name, ret);
+  }
+}
+
+ZTEST(parser_bench, test_tokenize) {
+  jsmn_parser tokenizer;
+
+  TC_PRINT(
+      "jsmn_parse() string scan: %s\n",
+      IS_ENABLED(CONFIG_JSON_SWAR_SCAN) ? "word at a time (SWAR)" : "byte at a time"
+  );
+  TC_PRINT("%-34s %7s %7s %10s %9s\n", "response", "bytes", "tokens", "ns/parse", "KB/s");
+
+  for (size_t i = 0; i < corpus_count; i++) {
+    const CorpusFile *file = &corpus[i];
+
+    /* Without a token array jsmn only counts the tokens, so this is the scan
+     * alone */
+    jsmn_init(&tokenizer);
+    const int tokens = jsmn_parse(&tokenizer, file->data, file->size, NULL, 0);
+
+    zassert_true(tokens > 0, "%s failed to tokenize: %d", file->name, tokens);
+
+    const uint64_t start = bench_time_ns();
+    for (int n = 0; n < CONFIG_PARSER_BENCH_ITERATIONS; n++) {
+      jsmn_init(&tokenizer);
+      (void)jsmn_parse(&tokenizer, file->data, file->size, NULL, 0);
+    }
+    const uint64_t ns = MAX((bench_time_ns() - start) / CONFIG_PARSER_BENCH_ITERATIONS, 1);
+
+    TC_PRINT(
+        "%-34s %7zu %7d %10llu %9llu\n", file->name, file->size, tokens, ns,
+        ((uint64_t)file->size * NSEC_PER_SEC) / ns / 1024
+    );
+  }
+}
+
+/** Whether len bytes at str are one of the keys in json_keys.txt */
+static bool is_json_key(const char *const names[], const char *str, size_t len) {
+  for (enum json_key key = JSON_KEY_UNKNOWN + 1; key < JSON_KEY_COUNT; key++) {
+    if ((strlen(names[key]) == len) && (memcmp(names[key], str, len) == 0)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+ZTEST(parser_bench, test_key_classify) {
+  static const char *const names[JSON_KEY_COUNT] = JSON_KEY_NAMES;
+  char near_miss[32];
+
+  zassert_equal(json_key_classify("", 0), JSON_KEY_UNKNOWN);
+
+  for (enum json_key key = JSON_KEY_UNKNOWN + 1; key < JSON_KEY_COUNT; key++) {
+    const size_t len = strlen(names[key]);
+
+    zassert_true(len < sizeof(near_miss));
+    zassert_equal(
+        json_key_classify(names[key], len), key, "%s isn't classified as itself", names[key]
+    );
+
+    /* Same length, first and last character, so the same slot as the key */
+    (void)memcpy(near_miss, names[key], len);
+    near_miss[len / 2] = (near_miss[len / 2] == '_') ? '-' : '_';
+    if ((len > 2) && !is_json_key(names, near_miss, len)) {
+      zassert_equal(
+          json_key_classify(near_miss, len), JSON_KEY_UNKNOWN, "%.*s", (int)len, near_miss
+      );
+    }
+
+    if (!is_json_key(names, names[key], len - 1)) {
+      zassert_equal(json_key_classify(names[key], len - 1), JSON_KEY_UNKNOWN);
+    }
+  }
+}
+
+/** Returns the 1 based index of the key tok matches in chain, or 0, the way
+ *  the jsoneq() chains worked. */
+static int jsoneq_chain(const char *json_ptr, const jsmntok_t *tok, const char *const *chain) {
+  for (int i = 0; chain[i] != NULL; i++) {
+    if (jsoneq(json_ptr, tok, chain[i])) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+/** Finds the keys of a response the jsoneq() chains looked at.
+ *
+ *  @return The number of keys, or a negative jsmn error.
+ */
+static int find_bench_keys(const CorpusFile *file) {
+  /* End of each open object and array */
+  int ends[KEY_BENCH_MAX_DEPTH];
+  int depth = 0;
+  int count = 0;
+  jsmn_parser tokenizer;
+
+  jsmn_init(&tokenizer);
+  const int tokens =
+      jsmn_parse(&tokenizer, file->data, file->size, key_bench_tokens, KEY_BENCH_TOKENS);
+
+  for (int t = 0; t < tokens; t++) {
+    const jsmntok_t *tok = &key_bench_tokens[t];
+
+    while ((depth > 0) && (ends[depth - 1] <= tok->start)) {
+      depth--;
+    }
+    /* Keys are strings with a value */
+    if ((tok->type == JSMN_STRING) && (tok->size == 1) && (depth < KEY_BENCH_MAX_DEPTH) &&
+        (key_chains[depth] != NULL)) {
+      bench_keys[count] = t;
+      bench_key_chains[count] = key_chains[depth];
+      count++;
+    }
+    if (((tok->type == JSMN_OBJECT) || (tok->type == JSMN_ARRAY)) &&
+        (depth < KEY_BENCH_MAX_DEPTH)) {
+      ends[depth++] = tok->end;
+    }
+  }
+  return (tokens < 0) ? tokens : count;
+}
+
+ZTEST(parser_bench, test_key_classify_speed) {
+  /* Keeps the results so the loops aren't optimized out */
+  volatile int sink = 0;
+
+  TC_PRINT("%-34s %6s %14s %14s\n", "response", "keys", "ns/key jsoneq", "ns/key hash");
+
+  for (size_t i = 0; i < corpus_count; i++) {
+    const CorpusFile *file = &corpus[i];
+    const int keys = find_bench_keys(file);
+
+    zassert_not_equal(
+        keys, JSMN_ERROR_NOMEM, "%s has more than %d tokens, raise KEY_BENCH_TOKENS", file->name,
+        KEY_BENCH_TOKENS
+    );
+    zassert_true(keys >= 0, "%s failed to tokenize: %d", file->name, keys);
+    if (keys == 0) {
+      continue;
+    }
+
+    uint64_t start = bench_time_ns();
+    for (int n = 0; n < CONFIG_PARSER_BENCH_ITERATIONS; n++) {
+      for (int k = 0; k < keys; k++) {
+        sink += jsoneq_chain(file->data, &key_bench_tokens[bench_keys[k]], bench_key_chains[k]);
+      }
+    }
+    const uint64_t jsoneq_ns = bench_time_ns() - start;
+
+    start = bench_time_ns();
+    for (int n = 0; n < CONFIG_PARSER_BENCH_ITERATIONS; n++) {
+      for (int k = 0; k < keys; k++) {
+        sink += json_key_tok(file->data, &key_bench_tokens[bench_keys[k]]);
+      }
+    }
+    const uint64_t classify_ns = bench_time_ns() - start;
+
+    const uint64_t lookups = (uint64_t)keys * CONFIG_PARSER_BENCH_ITERATIONS;
+
+    TC_PRINT(
+        "%-34s %6d %11llu.%02llu %11llu.%02llu\n", file->name, keys, jsoneq_ns / lookups,
+        ((jsoneq_ns * 100) / lookups) % 100, classify_ns / lookups,
+        ((classify_ns * 100) / lookups) % 100
+    );
+  }
+}
+
+ZTEST_SUITE(parser_bench, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Generates the stand-in server's certificates in this directory: a CA and a
+# server certificate for localhost, both RSA-2048. server.pem holds the chain
+# of both, as the BusTracker server sends it. Test use only, the keys are
+# public.
+set -e
+cd "$(dirname "$0")"
+
+openssl req -x509 -newkey rsa:2048 -nodes -keyout ca.key -out ca.pem -days 36500 \
+  -subj "/CN=Bench CA"
+openssl genrsa -traditional -out server.key 2048
+openssl req -new -key server.key -out server.csr -subj "/CN=localhost"
+printf "subjectAltName=DNS:localhost\n" > server.ext
+openssl x509 -req -in server.csr -CA ca.pem -CAkey ca.key -CAcreateserial -days 36500 \
+  -extfile server.ext -out leaf.pem
+cat leaf.pem ca.pem > server.pem
+
+rm ca.key ca.srl server.csr server.ext leaf.pem
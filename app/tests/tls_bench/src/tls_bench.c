@@ -0,0 +1,349 @@
+/* Times TLS handshakes with a stand-in server through a proxy that delays
+ * every flight by CONFIG_TLS_BENCH_DELAY_MS, without and with the session
+ * cache tls_setup() enables, and counts the handshake bytes each way.
+ *
+ * Only the proxy's delays take simulated time on native_sim, so the simulated
+ * time of a handshake is its round trips at the configured delay. The host
+ * time is what the handshake cost the CPU. */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/tls_credentials.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/ztest.h>
+
+#include "bench.h"
+
+#define SERVER_PORT 8443
+#define PROXY_PORT 9443
+#define THREAD_STACK_SIZE 8192
+/* The proxy only runs once both ends wait, so it forwards whole flights */
+#define SERVER_PRIORITY K_PRIO_PREEMPT(1)
+#define PROXY_PRIORITY K_PRIO_PREEMPT(2)
+
+#define CA_SEC_TAG 1
+#define SERVER_SEC_TAG 2
+/** TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256 */
+#define CIPHERSUITE 0xC02F
+
+/** Largest flight, the server's with its certificate chain */
+#define FLIGHT_SIZE 4096
+
+/* Mbed TLS parses PEM including its terminator */
+static const unsigned char ca_cert[] = {
+#include "certs/ca.pem.inc"
+    0x00
+};
+static const unsigned char server_cert[] = {
+#include "certs/server.pem.inc"
+    0x00
+};
+static const unsigned char server_key[] = {
+#include "certs/server.key.inc"
+    0x00
+};
+
+enum direction { UP, DOWN, DIRECTION_COUNT };
+
+/** A handshake as the proxy saw it */
+typedef struct Handshake {
+  /** Simulated time, the round trips at CONFIG_TLS_BENCH_DELAY_MS */
+  uint64_t sim_ms;
+  uint64_t host_ns;
+  uint64_t bytes[DIRECTION_COUNT];
+} Handshake;
+
+K_THREAD_STACK_DEFINE(server_stack, THREAD_STACK_SIZE);
+K_THREAD_STACK_DEFINE(proxy_stack, THREAD_STACK_SIZE);
+static struct k_thread server_thread;
+static struct k_thread proxy_thread;
+static int server_sock = -1;
+static int proxy_sock = -1;
+
+/** Bytes the proxy forwarded each way on the current connection */
+static size_t proxied[DIRECTION_COUNT];
+static char flight[FLIGHT_SIZE];
+K_SEM_DEFINE(proxy_done, 0, 1);
+
+static int send_all(int sock, const char *data, size_t len) {
+  while (len > 0) {
+    const ssize_t sent = zsock_send(sock, data, len, 0);
+
+    if (sent < 0) {
+      return -errno;
+    }
+    data += sent;
+    len -= sent;
+  }
+  return 0;
+}
+
+static int server_socket(int proto) {
+  const int reuse = 1;
+  const int sock = zsock_socket(AF_INET, SOCK_STREAM, proto);
+
+  zassert_true(sock >= 0, "socket() failed: %d", errno);
+  (void)zsock_setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  return sock;
+}
+
+static void server_listen(int sock, uint16_t port) {
+  struct sockaddr_in addr = {
+      .sin_family = AF_INET, .sin_port = htons(port), .sin_addr = INADDR_ANY_INIT
+  };
+
+  zassert_ok(zsock_bind(sock, (struct sockaddr *)&addr, sizeof(addr)));
+  zassert_ok(zsock_listen(sock, 1));
+}
+
+static int connect_to(int sock, uint16_t port) {
+  struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+
+  (void)zsock_inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  return zsock_connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+/** Stands in for the BusTracker server, keeping sessions to resume. Each
+ *  connection is only read until the client closes it. */
+static void server_run(void *p1, void *p2, void *p3) {
+  char buf[64];
+
+  while (true) {
+    const int sock = zsock_accept(server_sock, NULL, NULL);
+
+    if (sock < 0) {
+      return;
+    }
+    /* The handshake runs in the first recv() */
+    while (zsock_recv(sock, buf, sizeof(buf), 0) > 0) {
+    }
+    (void)zsock_close(sock);
+  }
+}
+
+/** Receives a whole flight, what arrived by the time the other end waits.
+ *
+ *  @return The flight's size, 0 once the connection closed.
+ */
+static ssize_t recv_flight(int sock) {
+  ssize_t len = zsock_recv(sock, flight, sizeof(flight), 0);
+
+  while ((len > 0) && (len < (ssize_t)sizeof(flight))) {
+    const ssize_t more =
+        zsock_recv(sock, &flight[len], sizeof(flight) - len, ZSOCK_MSG_DONTWAIT);
+
+    if (more <= 0) {
+      break;
+    }
+    len += more;
+  }
+  return len;
+}
+
+/** Forwards the client's connections to the server, delaying each flight
+ *  and counting its bytes. */
+static void proxy_run(void *p1, void *p2, void *p3) {
+  while (true) {
+    struct zsock_pollfd fds[DIRECTION_COUNT] = {
+        [UP] = {.events = ZSOCK_POLLIN}, [DOWN] = {.events = ZSOCK_POLLIN}
+    };
+    bool open = true;
+
+    fds[UP].fd = zsock_accept(proxy_sock, NULL, NULL);
+    if (fds[UP].fd < 0) {
+      return;
+    }
+    fds[DOWN].fd = zsock_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if ((fds[DOWN].fd < 0) || (connect_to(fds[DOWN].fd, SERVER_PORT) < 0)) {
+      open = false;
+    }
+
+    while (open && (zsock_poll(fds, ARRAY_SIZE(fds), -1) > 0)) {
+      for (int from = 0; open && (from < DIRECTION_COUNT); from++) {
+        if (fds[from].revents == 0) {
+          continue;
+        }
+
+        const ssize_t len = recv_flight(fds[from].fd);
+        if (len <= 0) {
+          open = false;
+          break;
+        }
+        k_sleep(K_MSEC(CONFIG_TLS_BENCH_DELAY_MS));
+        proxied[from] += len;
+        open = (send_all(fds[(from == UP) ? DOWN : UP].fd, flight, len) == 0);
+      }
+    }
+
+    (void)zsock_close(fds[UP].fd);
+    if (fds[DOWN].fd >= 0) {
+      (void)zsock_close(fds[DOWN].fd);
+    }
+    k_sem_give(&proxy_done);
+  }
+}
+
+/** Connects to the server through the proxy and times the handshake, with
+ *  the options tls_setup() sets.
+ *
+ *  @param session_cache Whether to resume the last session.
+ */
+static int handshake(bool session_cache, Handshake *result) {
+  const sec_tag_t sec_tags[] = {CA_SEC_TAG};
+  const int ciphersuites[] = {CIPHERSUITE};
+  const int verify = TLS_PEER_VERIFY_REQUIRED;
+  const int cache = session_cache ? TLS_SESSION_CACHE_ENABLED : TLS_SESSION_CACHE_DISABLED;
+  int64_t sim_start;
+  uint64_t host_start;
+  int err = 0;
+  int sock;
+
+  sock = zsock_socket(AF_INET, SOCK_STREAM, IPPROTO_TLS_1_2);
+  if (sock < 0) {
+    return -errno;
+  }
+  if ((zsock_setsockopt(sock, SOL_TLS, TLS_PEER_VERIFY, &verify, sizeof(verify)) < 0) ||
+      (zsock_setsockopt(sock, SOL_TLS, TLS_SEC_TAG_LIST, sec_tags, sizeof(sec_tags)) < 0) ||
+      (zsock_setsockopt(sock, SOL_TLS, TLS_HOSTNAME, "localhost", strlen("localhost")) < 0) ||
+      (zsock_setsockopt(
+           sock, SOL_TLS, TLS_CIPHERSUITE_LIST, ciphersuites, sizeof(ciphersuites)
+       ) < 0) ||
+      (zsock_setsockopt(sock, SOL_TLS, TLS_SESSION_CACHE, &cache, sizeof(cache)) < 0)) {
+    err = -errno;
+    goto clean_up;
+  }
+
+  proxied[UP] = 0;
+  proxied[DOWN] = 0;
+  sim_start = k_uptime_get();
+  host_start = bench_time_ns();
+
+  /* The handshake runs in connect() */
+  if (connect_to(sock, PROXY_PORT) < 0) {
+    err = -errno;
+    goto clean_up;
+  }
+  result->host_ns = bench_time_ns() - host_start;
+  result->sim_ms = k_uptime_get() - sim_start;
+
+  /* Let the client's last flight through before counting */
+  k_sleep(K_MSEC(2 * CONFIG_TLS_BENCH_DELAY_MS));
+  result->bytes[UP] = proxied[UP];
+  result->bytes[DOWN] = proxied[DOWN];
+
+clean_up:
+  (void)zsock_close(sock);
+  (void)k_sem_take(&proxy_done, K_SECONDS(10));
+  return err;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  const uint64_t x = *(const uint64_t *)a;
+  const uint64_t y = *(const uint64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static uint64_t median(uint64_t values[CONFIG_TLS_BENCH_HANDSHAKES]) {
+  qsort(values, CONFIG_TLS_BENCH_HANDSHAKES, sizeof(values[0]), compare_u64);
+  return values[CONFIG_TLS_BENCH_HANDSHAKES / 2];
+}
+
+/** Runs CONFIG_TLS_BENCH_HANDSHAKES handshakes and prints their medians.
+ *
+ *  @param result Set to the medians.
+ */
+static void run_handshakes(const char *name, bool session_cache, Handshake *result) {
+  static uint64_t sim_ms[CONFIG_TLS_BENCH_HANDSHAKES];
+  static uint64_t host_ns[CONFIG_TLS_BENCH_HANDSHAKES];
+  static uint64_t bytes[DIRECTION_COUNT][CONFIG_TLS_BENCH_HANDSHAKES];
+  Handshake handshake_result;
+
+  for (int i = 0; i < CONFIG_TLS_BENCH_HANDSHAKES; i++) {
+    const int err = handshake(session_cache, &handshake_result);
+
+    zassert_ok(err, "%s handshake %d failed: %d", name, i, err);
+    sim_ms[i] = handshake_result.sim_ms;
+    host_ns[i] = handshake_result.host_ns;
+    bytes[UP][i] = handshake_result.bytes[UP];
+    bytes[DOWN][i] = handshake_result.bytes[DOWN];
+  }
+
+  result->sim_ms = median(sim_ms);
+  result->host_ns = median(host_ns);
+  result->bytes[UP] = median(bytes[UP]);
+  result->bytes[DOWN] = median(bytes[DOWN]);
+  TC_PRINT(
+      "%-8s %8llu %10llu %8llu %8llu\n", name, result->sim_ms, result->host_ns / NSEC_PER_USEC,
+      result->bytes[UP], result->bytes[DOWN]
+  );
+}
+
+ZTEST(tls_bench, test_session_cache) {
+  Handshake full;
+  Handshake resumed;
+  Handshake first;
+
+  TC_PRINT(
+      "Medians of %d handshakes, %d ms each way\n", CONFIG_TLS_BENCH_HANDSHAKES,
+      CONFIG_TLS_BENCH_DELAY_MS
+  );
+  TC_PRINT("%-8s %8s %10s %8s %8s\n", "", "ms", "host us", "B up", "B down");
+
+  run_handshakes("full", false, &full);
+
+  /* The session the first cached connection gets is resumed by the next */
+  zassert_ok(handshake(true, &first));
+  run_handshakes("resumed", true, &resumed);
+
+  zassert_true(resumed.sim_ms < full.sim_ms, "Resuming didn't save a round trip");
+  zassert_true(
+      resumed.bytes[DOWN] < (sizeof(server_cert) / 2), "Resumed handshakes still got the chain"
+  );
+}
+
+static void *tls_setup_suite(void) {
+  const sec_tag_t sec_tags[] = {SERVER_SEC_TAG};
+  const int verify = TLS_PEER_VERIFY_NONE;
+  const int cache = TLS_SESSION_CACHE_ENABLED;
+
+  zassert_ok(
+      tls_credential_add(CA_SEC_TAG, TLS_CREDENTIAL_CA_CERTIFICATE, ca_cert, sizeof(ca_cert))
+  );
+  zassert_ok(tls_credential_add(
+      SERVER_SEC_TAG, TLS_CREDENTIAL_SERVER_CERTIFICATE, server_cert, sizeof(server_cert)
+  ));
+  zassert_ok(
+      tls_credential_add(SERVER_SEC_TAG, TLS_CREDENTIAL_PRIVATE_KEY, server_key, sizeof(server_key))
+  );
+
+  server_sock = server_socket(IPPROTO_TLS_1_2);
+  zassert_ok(zsock_setsockopt(server_sock, SOL_TLS, TLS_SEC_TAG_LIST, sec_tags, sizeof(sec_tags)));
+  zassert_ok(zsock_setsockopt(server_sock, SOL_TLS, TLS_PEER_VERIFY, &verify, sizeof(verify)));
+  zassert_ok(zsock_setsockopt(server_sock, SOL_TLS, TLS_SESSION_CACHE, &cache, sizeof(cache)));
+  server_listen(server_sock, SERVER_PORT);
+
+  proxy_sock = server_socket(IPPROTO_TCP);
+  server_listen(proxy_sock, PROXY_PORT);
+
+  (void)k_thread_create(
+      &server_thread, server_stack, K_THREAD_STACK_SIZEOF(server_stack), server_run, NULL, NULL,
+      NULL, SERVER_PRIORITY, 0, K_NO_WAIT
+  );
+  (void)k_thread_create(
+      &proxy_thread, proxy_stack, K_THREAD_STACK_SIZEOF(proxy_stack), proxy_run, NULL, NULL,
+      NULL, PROXY_PRIORITY, 0, K_NO_WAIT
+  );
+  return NULL;
+}
+
+static void tls_teardown_suite(void *fixture) {
+  k_thread_abort(&server_thread);
+  k_thread_abort(&proxy_thread);
+  (void)zsock_close(server_sock);
+  (void)zsock_close(proxy_sock);
+}
+
+ZTEST_SUITE(tls_bench, NULL, tls_setup_suite, NULL, NULL, tls_teardown_suite);
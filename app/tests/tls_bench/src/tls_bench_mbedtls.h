@@ -0,0 +1,5 @@
+/* Included by Mbed TLS after its generated config */
+
+/* The stand-in server keeps sessions to resume, the client side cache is
+ * CONFIG_NET_SOCKETS_TLS_MAX_CLIENT_SESSION_COUNT */
+#define MBEDTLS_SSL_CACHE_C